@@ -5,24 +5,34 @@
 #include <iomanip>
 #include <iostream>
 #endif
+#include "heap.hpp"
+#include <atomic>
 #include <cmath>
+#include <deque>
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
 #include <optional>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 class GDTWriter;
+class GraphManager;
 class Router;
 class Segment;
+class RouteCandidate;
+class RerouteQueue;
 // Forward declaration of A_Star namespace and Grid class
 namespace A_Star
 {
 struct Point;
 class Grid;
+class PathInfo;
+class RunLengthPath;
 } // namespace A_Star
 
 // Float point comparison
@@ -412,6 +422,14 @@ public:
     // Methods
 };
 
+// Order in which the nets waiting for a reroute are taken
+enum class ReroutePriority
+{
+    FIFO,           // queue order
+    MOST_CONFLICTS, // nets ripped up most often first
+    HISTORY_COST,   // nets whose path runs through the most cost (history and other paths) first
+};
+
 class DataManager
 {
 private:
@@ -438,6 +456,20 @@ private:
     std::unordered_map<std::string, std::unordered_map<int, std::pair<int, int>>>
         m_group_escape_layer_order; // group name, escape length
     std::unordered_map<int, std::shared_ptr<A_Star::Grid>> m_grids;
+    bool m_integer_cost_search; // A* grids use fixed-point costs and a radix heap
+    bool m_jump_point_search;   // A* grids jump over open, zero-cost runs
+    bool m_bidirectional_search; // A* grids search from both escape points
+    bool m_incremental_search;   // CPU2DDR_A_Star keeps every net's search tree and repairs it (LPA*) on a reroute
+    bool m_distance_heuristic;   // A* grids cache an obstacle-aware distance field per goal as their heuristic
+    int m_grid_margin;           // cells added around the escape points' bounding box for the A* grid window
+    int m_net_corridor_margin;   // cells added around a net's start/end box to bound its search, 0 disables it
+    bool m_coarse_routing;       // CPU2DDR_A_Star routes each net on the GR cells first and searches only near them
+    int m_coarse_margin;         // GR cells added around a net's coarse path for its fine search
+    int m_routing_threads;       // threads routing the layers of CPU2DDR_A_Star concurrently, 0 = hardware threads
+    bool m_per_layer_routing_attempts; // max_routing_attempts of CPU2DDR_A_Star counts per layer instead of in total
+    bool m_parallel_escape_search; // DDR2DDR tries the expand and maximum_layer configurations concurrently
+    int m_escape_threads;          // threads of the escape routing stage, 0 = hardware threads
+    ReroutePriority m_reroute_priority; // order of the nets waiting for a reroute in CPU2DDR_A_Star
     std::vector<std::vector<Segment>> m_data_signals;
     // GR
     double m_GR_cell_width;
@@ -461,6 +493,23 @@ public:
         m_wire_spacing = 4.8;
         m_wire_width = 4.0;
         m_minimum_segment = 5.0;
+        m_integer_cost_search = false;
+        m_incremental_search = false;
+        m_distance_heuristic = false;
+        m_jump_point_search = false;
+        m_bidirectional_search = false;
+        m_grid_margin = 100;
+        m_net_corridor_margin = 0;
+        m_coarse_routing = false;
+        m_coarse_margin = 1;
+        m_GR_cell_width = 0;
+        m_GR_cell_height = 0;
+        m_GR_Left_Bottom = std::make_pair(0.0, 0.0);
+        m_routing_threads = 0;
+        m_per_layer_routing_attempts = false;
+        m_parallel_escape_search = false;
+        m_escape_threads = 0;
+        m_reroute_priority = ReroutePriority::FIFO;
     };
     // Accessor
     // Access for components
@@ -536,6 +585,48 @@ public:
     // Access for grids
     const std::unordered_map<int, std::shared_ptr<A_Star::Grid>> &grids() const { return m_grids; }
     std::unordered_map<int, std::shared_ptr<A_Star::Grid>> &grids() { return m_grids; }
+    // Access for integer_cost_search
+    const bool &integer_cost_search() const { return m_integer_cost_search; }
+    bool &integer_cost_search() { return m_integer_cost_search; }
+    // Access for jump_point_search
+    const bool &jump_point_search() const { return m_jump_point_search; }
+    bool &jump_point_search() { return m_jump_point_search; }
+    // Access for bidirectional_search
+    const bool &bidirectional_search() const { return m_bidirectional_search; }
+    bool &bidirectional_search() { return m_bidirectional_search; }
+    // Access for grid_margin
+    const int &grid_margin() const { return m_grid_margin; }
+    int &grid_margin() { return m_grid_margin; }
+    // Access for net_corridor_margin
+    const int &net_corridor_margin() const { return m_net_corridor_margin; }
+    int &net_corridor_margin() { return m_net_corridor_margin; }
+    // Access for incremental_search
+    const bool &incremental_search() const { return m_incremental_search; }
+    bool &incremental_search() { return m_incremental_search; }
+    // Access for distance_heuristic
+    const bool &distance_heuristic() const { return m_distance_heuristic; }
+    bool &distance_heuristic() { return m_distance_heuristic; }
+    // Access for coarse_routing
+    const bool &coarse_routing() const { return m_coarse_routing; }
+    bool &coarse_routing() { return m_coarse_routing; }
+    // Access for coarse_margin
+    const int &coarse_margin() const { return m_coarse_margin; }
+    int &coarse_margin() { return m_coarse_margin; }
+    // Access for routing_threads
+    const int &routing_threads() const { return m_routing_threads; }
+    int &routing_threads() { return m_routing_threads; }
+    // Access for per_layer_routing_attempts
+    const bool &per_layer_routing_attempts() const { return m_per_layer_routing_attempts; }
+    bool &per_layer_routing_attempts() { return m_per_layer_routing_attempts; }
+    // Access for parallel_escape_search
+    const bool &parallel_escape_search() const { return m_parallel_escape_search; }
+    bool &parallel_escape_search() { return m_parallel_escape_search; }
+    // Access for escape_threads
+    const int &escape_threads() const { return m_escape_threads; }
+    int &escape_threads() { return m_escape_threads; }
+    // Access for reroute_priority
+    const ReroutePriority &reroute_priority() const { return m_reroute_priority; }
+    ReroutePriority &reroute_priority() { return m_reroute_priority; }
     // Access for data_signals
     const std::vector<std::vector<Segment>> &data_signals() const { return m_data_signals; }
     std::vector<std::vector<Segment>> &data_signals() { return m_data_signals; }
@@ -555,8 +646,21 @@ public:
     void storeGroupLayer();
     void distributeLayerByGroup();
     void preprocess_ER();
-    void DDR2DDR();
-    void CPU2DDR();
+    // Escape route the DDRs and the CPU concurrently, one task per component on a work-stealing pool
+    void escapeRouting(bool ddr = true, bool cpu = true);
+    void DDR2DDR() { escapeRouting(true, false); }
+    void CPU2DDR() { escapeRouting(false, true); }
+    // Escape route one component, the DDR log lines are kept to be printed in component order
+    void DDR2DDR(Component &comp, std::vector<std::string> &log);
+    void CPU2DDR(Component &comp);
+    // One escape attempt of a DDR, return the flow reached. It gives up before a min-cost solve once cancelled()
+    long escapeDDR(GraphManager &graph_manager,
+                   Component &comp,
+                   const std::vector<std::unordered_set<int>> &pinsets,
+                   int expand,
+                   int maximum_layer,
+                   const GraphManager *previous,
+                   const std::function<bool()> &cancelled = nullptr);
     void postprocess_ER();
     void extendCPUEscapePoint(const double &outtest_coordinate,
                               std::vector<std::pair<Coordinate, int>> &cpu_escape_point);
@@ -567,8 +671,11 @@ public:
     void createGrid(const std::vector<std::pair<Coordinate, int>> &cpu_ep,
                     const std::vector<std::pair<Coordinate, int>> &ddr_ep,
                     const double &pitch);
+    std::shared_ptr<A_Star::Grid>
+    makeGrid(const Coordinate &bottom_left, const Coordinate &top_right, const double &pitch) const;
+    A_Star::Point growGrid(const int layer, const int margin);
     void addPointsPath2Segments(A_Star::Grid &grid,
-                                std::vector<A_Star::Point> &point_path,
+                                A_Star::RunLengthPath path,
                                 const int net_id,
                                 const int layer,
                                 const Coordinate &start,
@@ -577,7 +684,14 @@ public:
                         const std::vector<std::pair<Coordinate, int>> &ddr_ep,
                         const A_Star::Point &parent,
                         const int &max_routing_attempts = 1e9);
-    void markExistingObstacles();
+    bool routeLayer(const int layer,
+                    RerouteQueue &route_candidates,
+                    const std::unordered_map<int, RouteCandidate> &route_information,
+                    std::unordered_map<int, A_Star::PathInfo> &paths,
+                    const A_Star::Point &parent_direction,
+                    std::atomic<int> &num_routes,
+                    const int &max_routing_attempts);
+    void markExistingObstacles(const std::optional<int> &only_layer = std::nullopt);
     void DDR2DDRAreaRouting();
     void CPU2DDRAreaRouting();
     void AreaRouting();
@@ -929,40 +1043,73 @@ public:
     }
 
     // Function to generate the path between two coordinates using octile distance
+    // at most one diagonal segment followed by one orthogonal segment, a start that equals end gives no segment
     static std::vector<Segment> generatePath(const Coordinate &start, const Coordinate &end, int net_id = -1)
     {
+        if (start.z() != end.z())
+        {
+            throw std::invalid_argument("Segment::generatePath Start and end z are not the same.");
+        }
         std::vector<Segment> path;
-        Coordinate current = start;
-
-        while (current != end)
+        if (start == end)
         {
-            std::vector<Coordinate> adjacents = current.getAdjacentCoordinates();
-            double min_distance = std::numeric_limits<double>::infinity();
-            Coordinate next;
-
-            for (const auto &adj : adjacents)
-            {
-                double distance = calculateOctileDistance(adj, end);
-                if (distance < min_distance)
-                {
-                    min_distance = distance;
-                    next = adj;
-                }
-            }
-
-            path.emplace_back(current, next, net_id);
-            current = next;
+            return path;
         }
-
+        double dx = end.x() - start.x();
+        double dy = end.y() - start.y();
+        double diagonal = std::min(std::abs(dx), std::abs(dy));
+        // a pure diagonal or orthogonal connection is a single segment
+        if (deq(diagonal, 0) || deq(std::abs(dx), std::abs(dy)))
+        {
+            path.emplace_back(start, end, net_id);
+            return path;
+        }
+        Coordinate corner(start.x() + std::copysign(diagonal, dx), start.y() + std::copysign(diagonal, dy), start.z());
+        path.emplace_back(start, corner, net_id);
+        path.emplace_back(corner, end, net_id);
         return path;
     }
 };
 
+// Stable reference to a segment of a Router, it stays valid while other segments are added, merged or removed
+struct SegmentHandle
+{
+    uint32_t slot = std::numeric_limits<uint32_t>::max();
+    uint32_t generation = 0;
+};
+
 class Router
 {
 private:
     std::vector<Segment> m_segments;
     std::vector<Via> m_vias;
+    // endpoint index for addSegment: 1x1 buckets of endpoints -> segment positions, a segment is filed under the
+    // buckets of its start and end. It is rebuilt after m_segments was handed out for writing.
+    std::unordered_map<uint64_t, std::vector<size_t>> m_endpoint_index;
+    std::vector<std::pair<uint64_t, uint64_t>> m_endpoint_keys; // buckets each segment is filed under
+    std::set<size_t> m_unjoined; // segments whose touching pairs have to be checked again
+    bool m_indexed = false;
+    // slot map behind the segment handles, a released slot is reused with the next generation
+    struct Slot
+    {
+        size_t position = std::numeric_limits<size_t>::max(); // in m_segments, max() while the slot is free
+        uint32_t generation = 0;
+    };
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_free_slots;
+    std::vector<uint32_t> m_slot_of; // position -> slot
+    bool m_has_removed = false;      // removed segments stay in m_segments until compact()
+
+    static uint64_t endpointKey(long long x, long long y, int z);
+    void indexSegments();
+    void fileSegment(size_t i);
+    void unfileSegment(size_t i);
+    std::vector<size_t> touchingSegments(size_t i) const;
+    bool joinSegments(Segment &s, Segment &other_s, std::vector<Segment> &diagonals);
+    void appendSegment(const Segment &segment);
+    void releaseSlot(size_t i);
+    void syncSlots();
+    void compact();
 
 public:
     // Constructor
@@ -970,31 +1117,39 @@ public:
     // Accessor
     // Access for segments
     const std::vector<Segment> &segments() const { return m_segments; }
-    std::vector<Segment> &segments() { return m_segments; }
+    std::vector<Segment> &segments()
+    {
+        compact();
+        m_indexed = false;
+        return m_segments;
+    }
     // Access for vias
     const std::vector<Via> &vias() const { return m_vias; }
     std::vector<Via> &vias() { return m_vias; }
+    // Access for segments by handle, handle(i) is the segment at segments()[i]
+    SegmentHandle handle(size_t i)
+    {
+        syncSlots();
+        return SegmentHandle{m_slot_of[i], m_slots[m_slot_of[i]].generation};
+    }
+    bool isValid(const SegmentHandle &handle) const
+    {
+        return m_slot_of.size() == m_segments.size() && handle.slot < m_slots.size() &&
+               m_slots[handle.slot].generation == handle.generation &&
+               m_slots[handle.slot].position != std::numeric_limits<size_t>::max();
+    }
+    const Segment &segment(const SegmentHandle &handle) const { return m_segments[m_slots[handle.slot].position]; }
     // Methods
     void addSegment(Segment segment);
+    // Add the segments first and join them in one go, cheaper than adding them one by one
+    void addSegments(const std::vector<Segment> &segments);
     void addVia(Via via) { m_vias.push_back(via); }
-    void setViaNetId();
-    void setSegmentNetId();
-    void removeSegment(Segment segment)
-    {
-        // remove the segment from the vector
-        // iterate the segments it and remove it
-        for (auto it = m_segments.begin(); it != m_segments.end();)
-        {
-            if (*it == segment)
-            {
-                it = m_segments.erase(it);
-            }
-            else
-            {
-                ++it;
-            }
-        }
-    }
+    // Give touching segments and vias the largest net_id among them, throw if they carry different nets
+    void setNetId();
+    void removeSegment(Segment segment);
+    // Remove the segment in O(1), an invalid handle is ignored. The segment leaves segments() at the next compaction
+    // (addSegments or non-const segments()), handles of the other segments stay valid.
+    void removeSegment(const SegmentHandle &handle);
 };
 
 class RouteCandidate
@@ -1013,4 +1168,89 @@ public:
     {
     }
 };
+
+// Nets of one layer waiting for a (re)route. Membership is a bitset over net ids, so "is it already queued" is O(1).
+// FIFO keeps the queue order, the other priorities pop the highest score first and break ties by queue order.
+class RerouteQueue
+{
+private:
+    struct Key
+    {
+        double score;
+        uint64_t order;
+        bool operator<(const Key &other) const
+        {
+            return score > other.score || (score == other.score && order < other.order);
+        }
+    };
+    ReroutePriority m_priority;
+    std::vector<bool> m_queued; // net_id -> waiting
+    std::deque<RouteCandidate> m_fifo;
+    IndexedHeap<Key> m_heap; // keyed by net_id
+    std::unordered_map<int, RouteCandidate> m_candidates; // waiting candidates of the heap, by net_id
+    uint64_t m_order = 0;
+
+public:
+    // Constructor, net ids have to be in [0, num_nets)
+    RerouteQueue(const size_t num_nets = 0, const ReroutePriority priority = ReroutePriority::FIFO)
+        : m_priority(priority)
+        , m_queued(num_nets, false)
+        , m_heap(priority == ReroutePriority::FIFO ? 0 : num_nets)
+    {
+    }
+    // Accessor
+    const ReroutePriority &priority() const { return m_priority; }
+    bool empty() const { return m_fifo.empty() && m_heap.empty(); }
+    size_t size() const { return m_fifo.size() + m_heap.size(); }
+    bool contains(const int net_id) const
+    {
+        return net_id >= 0 && static_cast<size_t>(net_id) < m_queued.size() && m_queued[net_id];
+    }
+    // Methods
+    // Queue rc, return false if its net is already waiting (it keeps its place, a higher score still applies)
+    bool push(const RouteCandidate &rc, const double score = 0)
+    {
+        if (rc.net_id < 0 || static_cast<size_t>(rc.net_id) >= m_queued.size())
+        {
+            throw std::runtime_error("RerouteQueue push: net_id " + std::to_string(rc.net_id) + " is out of range");
+        }
+        if (m_priority == ReroutePriority::FIFO)
+        {
+            if (m_queued[rc.net_id])
+            {
+                return false;
+            }
+            m_fifo.push_back(rc);
+        }
+        else if (m_queued[rc.net_id])
+        {
+            m_heap.decrease(rc.net_id, Key{score, m_heap.priority(rc.net_id).order});
+            return false;
+        }
+        else
+        {
+            m_heap.push(rc.net_id, Key{score, m_order++});
+            m_candidates[rc.net_id] = rc;
+        }
+        m_queued[rc.net_id] = true;
+        return true;
+    }
+    RouteCandidate pop()
+    {
+        RouteCandidate rc;
+        if (m_priority == ReroutePriority::FIFO)
+        {
+            rc = m_fifo.front();
+            m_fifo.pop_front();
+        }
+        else
+        {
+            auto it = m_candidates.find(m_heap.pop());
+            rc = it->second;
+            m_candidates.erase(it);
+        }
+        m_queued[rc.net_id] = false;
+        return rc;
+    }
+};
 #endif // COMPONENT_DATA_HPP
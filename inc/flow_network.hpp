@@ -0,0 +1,92 @@
+#ifndef FLOW_NETWORK_HPP
+#define FLOW_NETWORK_HPP
+#include "heap.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Residual flow network in compressed sparse row form. addArc(u, v) adds the arc u -> v with id 2k and its paired
+// reverse arc v -> u (capacity 0, negated cost) with id 2k + 1, so the pair of arc a is a ^ 1. The arcs are kept
+// sorted by tail (in insertion order for the same tail), build() redoes the layout after arcs were added and keeps
+// the capacities and residuals of the arcs already there. Arc ids stay valid across builds.
+class FlowNetwork
+{
+private:
+    int32_t m_num_vertices = 0;
+    // CSR layout, the out arcs of u are the slots [m_offsets[u], m_offsets[u + 1])
+    std::vector<int32_t> m_offsets;
+    std::vector<int32_t> m_heads;
+    std::vector<int32_t> m_capacities;
+    std::vector<int32_t> m_residuals;
+    std::vector<int32_t> m_costs;
+    std::vector<int32_t> m_pairs; // slot of the paired arc
+    std::vector<int32_t> m_arcs;  // slot -> arc id
+    std::vector<int32_t> m_slots; // arc id -> slot
+    std::vector<int32_t> m_tails; // arc id -> tail, to redo the layout
+    // Arcs added since the last build, their ids follow the ones already laid out
+    struct PendingArc
+    {
+        int32_t tail;
+        int32_t head;
+        int32_t capacity;
+        int32_t cost;
+    };
+    std::vector<PendingArc> m_pending;
+    // Solver buffers, reused between solves
+    std::vector<int64_t> m_potentials;
+    std::vector<int64_t> m_distances;
+    std::vector<int32_t> m_predecessors; // slot of the arc the shortest path enters a vertex with
+    std::vector<char> m_done;
+    IndexedHeap<int64_t> m_heap;
+
+    bool built() const { return m_pending.empty() && m_offsets.size() == static_cast<size_t>(m_num_vertices) + 1; }
+
+public:
+    // Constructor
+    FlowNetwork() = default;
+    // Accessor
+    int32_t numVertices() const { return m_num_vertices; }
+    // Number of arcs, the reverse arcs included
+    int32_t numArcs() const { return static_cast<int32_t>(m_tails.size()); }
+    int32_t tail(int32_t arc) const { return m_tails[arc]; }
+    int32_t head(int32_t arc) const { return m_heads[m_slots[arc]]; }
+    int32_t capacity(int32_t arc) const { return m_capacities[m_slots[arc]]; }
+    int32_t residual(int32_t arc) const { return m_residuals[m_slots[arc]]; }
+    int32_t cost(int32_t arc) const { return m_costs[m_slots[arc]]; }
+    int32_t flow(int32_t arc) const { return capacity(arc) - residual(arc); }
+    // Arc ids in CSR order, i.e. grouped by tail, valid after build()
+    const std::vector<int32_t> &arcs() const { return m_arcs; }
+    void setCapacity(int32_t arc, int32_t capacity) { m_capacities[m_slots[arc]] = capacity; }
+    void setResidual(int32_t arc, int32_t residual) { m_residuals[m_slots[arc]] = residual; }
+    // Send amount more units along arc, i.e. take it from its residual and give it to the paired arc
+    void push(int32_t arc, int32_t amount)
+    {
+        m_residuals[m_slots[arc]] -= amount;
+        m_residuals[m_slots[arc ^ 1]] += amount;
+    }
+    size_t memoryUsage() const;
+    // Methods
+    int32_t addVertex() { return m_num_vertices++; }
+    // Add u -> v and its reverse arc, return the id of u -> v
+    int32_t addArc(int32_t u, int32_t v, int32_t capacity, int32_t cost);
+    // Lay out the arcs added since the last build, nothing to do when there are none
+    void build();
+    template <typename F>
+    void forEachOutArc(int32_t u, F &&f) const
+    {
+        for (int32_t slot = m_offsets[u]; slot < m_offsets[u + 1]; ++slot)
+        {
+            f(m_arcs[slot]);
+        }
+    }
+    // Successive shortest paths with Dijkstra on reduced costs, costs must be non-negative. Every solve starts from
+    // zero flow on the current capacities, like the Boost solver it replaces. Return the flow and its cost.
+    std::pair<int64_t, int64_t> minCostMaxFlow(int32_t s, int32_t t);
+    // Drop all flow, every residual goes back to its capacity
+    void clearFlow();
+    // Augment the flow already in the network with shortest (BFS) augmenting paths, costs are ignored. Return the
+    // flow added, so seeding a flow first only leaves the missing part to search for.
+    int64_t maxFlow(int32_t s, int32_t t);
+};
+
+#endif // FLOW_NETWORK_HPP
@@ -1,42 +1,24 @@
 #ifndef GRAPH_HPP
 #define GRAPH_HPP
-// clang-format off
 #include "component_data.hpp"
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/successive_shortest_path_nonnegative_weights.hpp>
-#include <boost/graph/cycle_canceling.hpp>
-#include <boost/graph/edmonds_karp_max_flow.hpp>
-#include <boost/graph/find_flow_cost.hpp>
-#include <boost/graph/depth_first_search.hpp>
-#include <vector>
+#include "flow_network.hpp"
+#include <cstdint>
 #include <map>
-using namespace boost;
+#include <vector>
 #define INF 1e9
-typedef adjacency_list_traits<vecS, vecS, directedS> Traits;
-typedef adjacency_list<vecS, vecS, directedS, no_property,
-        property<edge_capacity_t, long,
-            property<edge_residual_capacity_t, long,
-                property<edge_reverse_t, Traits::edge_descriptor,
-                    property<edge_weight_t, long>>>>> Graph;
-// clang-format on
 class TileNode
 {
 private:
-    Traits::vertex_descriptor m_N;
-    Traits::vertex_descriptor m_S;
-    Traits::vertex_descriptor m_E;
-    Traits::vertex_descriptor m_W;
-    Traits::vertex_descriptor m_C;
-    Traits::vertex_descriptor m_d_C;
+    int32_t m_N;
+    int32_t m_S;
+    int32_t m_E;
+    int32_t m_W;
+    int32_t m_C;
+    int32_t m_d_C;
 
 public:
     TileNode() = default;
-    TileNode(Traits::vertex_descriptor N,
-             Traits::vertex_descriptor S,
-             Traits::vertex_descriptor E,
-             Traits::vertex_descriptor W,
-             Traits::vertex_descriptor C,
-             Traits::vertex_descriptor d_C)
+    TileNode(int32_t N, int32_t S, int32_t E, int32_t W, int32_t C, int32_t d_C)
         : m_N(N)
         , m_S(S)
         , m_E(E)
@@ -47,44 +29,66 @@ public:
     }
     ~TileNode() = default;
     // Accessor
-    const Traits::vertex_descriptor &N() const { return m_N; }
-    Traits::vertex_descriptor &N() { return m_N; }
-    const Traits::vertex_descriptor &S() const { return m_S; }
-    Traits::vertex_descriptor &S() { return m_S; }
-    const Traits::vertex_descriptor &E() const { return m_E; }
-    Traits::vertex_descriptor &E() { return m_E; }
-    const Traits::vertex_descriptor &W() const { return m_W; }
-    Traits::vertex_descriptor &W() { return m_W; }
-    const Traits::vertex_descriptor &C() const { return m_C; }
-    Traits::vertex_descriptor &C() { return m_C; }
-    const Traits::vertex_descriptor &d_C() const { return m_d_C; }
-    Traits::vertex_descriptor &d_C() { return m_d_C; }
+    const int32_t &N() const { return m_N; }
+    int32_t &N() { return m_N; }
+    const int32_t &S() const { return m_S; }
+    int32_t &S() { return m_S; }
+    const int32_t &E() const { return m_E; }
+    int32_t &E() { return m_E; }
+    const int32_t &W() const { return m_W; }
+    int32_t &W() { return m_W; }
+    const int32_t &C() const { return m_C; }
+    int32_t &C() { return m_C; }
+    const int32_t &d_C() const { return m_d_C; }
+    int32_t &d_C() { return m_d_C; }
+};
+// What a flow vertex stands for, row and column index the pin array or the tiles, layer is set for rows and columns
+struct VertexInfo
+{
+    enum class Kind : uint8_t
+    {
+        NONE,
+        SOURCE,
+        SINK,
+        PIN,
+        TILE,         // side N, S, E, W or C of a tile
+        DUMMY_CENTER, // dC of a tile
+        ROW,
+        DUMMY_ROW,
+        COLUMN,
+        DUMMY_COLUMN,
+    };
+    Kind kind = Kind::NONE;
+    char side = 0;
+    int row = -1;
+    int column = -1;
+    int layer = -1;
 };
 class GraphManager
 {
 private:
     DataManager *m_data_manager;
     Component *m_component;
-    Graph g;
-    property_map<Graph, edge_capacity_t>::type capacity;
-    property_map<Graph, edge_weight_t>::type weight;
-    property_map<Graph, edge_residual_capacity_t>::type residual_capacity;
-    property_map<Graph, edge_reverse_t>::type rev;
+    FlowNetwork m_network;
 
-    Traits::vertex_descriptor s, t;
-    std::vector<std::vector<Traits::vertex_descriptor>> m_v;
+    int32_t s, t;
+    // tile index of the pin array corner, the tiles before it are bloat tiles
+    int m_base_tile_row = 0;
+    int m_base_tile_column = 0;
+    std::vector<std::vector<int32_t>> m_v;
     std::vector<std::vector<TileNode>> m_tiles;
-    std::vector<std::vector<Traits::vertex_descriptor>> m_rows;
-    std::vector<std::vector<Traits::vertex_descriptor>> m_d_rows;
-    std::vector<std::vector<Traits::vertex_descriptor>> m_columns;
-    std::vector<std::vector<Traits::vertex_descriptor>> m_d_columns;
-    std::vector<std::string> m_vertex_names;
-    std::map<adjacency_list_traits<vecS, vecS, directedS>::edge_descriptor, std::pair<int, int>>
-        stored_capacity_and_residual;
+    std::vector<std::vector<int32_t>> m_rows;
+    std::vector<std::vector<int32_t>> m_d_rows;
+    std::vector<std::vector<int32_t>> m_columns;
+    std::vector<std::vector<int32_t>> m_d_columns;
+    std::vector<VertexInfo> m_vertex_infos;
+    std::map<int32_t, std::pair<int32_t, int32_t>> stored_capacity_and_residual; // arc id, capacity and residual
     // Private Methods
-    void add_v(Graph &g, Traits::vertex_descriptor &v, std::string name);
-    void add_v(Graph &g, TileNode &tile_node, std::string name);
-    Graph reverseGraph(Graph &g);
+    void add_v(int32_t &v, VertexInfo info);
+    void add_v(TileNode &tile_node, int row, int column);
+    // Same key for the same pin, tile, row or column in graphs built with different expands and layers
+    uint64_t vertexKey(int32_t v) const;
+    long seedFlow(const GraphManager &previous);
 
 public:
     // Constructor
@@ -92,7 +96,8 @@ public:
     ~GraphManager() = default;
     void fixFlowResults();
     void restoreFlowResults();
-    void addSource2Pins(Component &component, std::unordered_set<int> &pinset);
+    // Return the number of pins connected to the source
+    long addSource2Pins(Component &component, std::unordered_set<int> &pinset);
     void DDR2DDRInit(DataManager &data_manager, Component &component, int expand, size_t maximum_layer);
     void CPU2DDRInit(DataManager &data_manager,
                      Component &component,
@@ -101,6 +106,8 @@ public:
                      double bump_ball_radius,
                      std::string escape_boundary);
     long minCostMaxFlow();
+    // Max flow without costs, warm-started with the flow of an earlier attempt, an upper bound of minCostMaxFlow()
+    long maxFlow(const GraphManager *previous);
     std::pair<Coordinate, Coordinate> DDR2DDR(std::shared_ptr<Router> router);
     void CPU2DDR(std::shared_ptr<Router> router, Component &component, std::string cpu_escape_boundary);
 };
@@ -1,6 +1,15 @@
 #ifndef GRID_HPP
 #define GRID_HPP
 #include "component_data.hpp"
+#include "heap.hpp"
+#include "paged_array.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 namespace A_Star
 {
@@ -26,22 +35,6 @@ struct PointHash
     std::size_t operator()(const Point &pt) const { return std::hash<int>()(pt.x) + 31 * std::hash<int>()(pt.y); }
 };
 
-struct Node
-{
-    Point point;
-    double cost;
-    double priority;
-    Point parent;
-    Node(Point pt, double c, double p, Point prnt)
-        : point(pt)
-        , cost(c)
-        , priority(p)
-        , parent(prnt)
-    {
-    }
-    bool operator>(const Node &other) const { return priority > other.priority; }
-};
-
 inline double heuristic(const Point &a, const Point &b)
 {
     int dx = abs(a.x - b.x);
@@ -143,12 +136,433 @@ inline void parentLookupTable(Point &parent, const std::string &direction, const
     return;
 }
 
+// Cell numbering of the tiled planes: the grid is cut into TILE_SIZE x TILE_SIZE tiles and cells are numbered tile
+// by tile (x-major inside a tile), so every tile is one contiguous index range that can be paged in on its own
+constexpr int TILE_BITS = 6;
+constexpr int TILE_SIZE = 1 << TILE_BITS;
+constexpr int TILE_CELLS = TILE_SIZE * TILE_SIZE;
+
+struct TileLayout
+{
+    int rows = 0;
+    int cols = 0;
+    int tile_cols = 0; // tiles along y
+
+    TileLayout() = default;
+    TileLayout(int rows, int cols)
+        : rows(rows)
+        , cols(cols)
+        , tile_cols((cols + TILE_SIZE - 1) >> TILE_BITS)
+    {
+    }
+    // Number of indices including the unused cells of the partial tiles on the top/right border
+    size_t size() const
+    {
+        return static_cast<size_t>((rows + TILE_SIZE - 1) >> TILE_BITS) * tile_cols * TILE_CELLS;
+    }
+    int32_t index(int x, int y) const
+    {
+        int32_t tile = (x >> TILE_BITS) * tile_cols + (y >> TILE_BITS);
+        return (tile << (2 * TILE_BITS)) | ((x & (TILE_SIZE - 1)) << TILE_BITS) | (y & (TILE_SIZE - 1));
+    }
+    Point point(int32_t index) const
+    {
+        int32_t tile = index >> (2 * TILE_BITS);
+        return Point(((tile / tile_cols) << TILE_BITS) | ((index >> TILE_BITS) & (TILE_SIZE - 1)),
+                     ((tile % tile_cols) << TILE_BITS) | (index & (TILE_SIZE - 1)));
+    }
+};
+
+// Bit-packed obstacle plane, one bit per cell in TileLayout order. A tile is allocated on its first obstacle.
+class ObstaclePlane
+{
+private:
+    TileLayout m_layout;
+    PagedArray<uint64_t, TILE_BITS> m_words; // one word per tile row, so one page per tile
+
+public:
+    // Constructor
+    ObstaclePlane() = default;
+    ObstaclePlane(int rows, int cols)
+        : m_layout(rows, cols)
+        , m_words(m_layout.size() / 64)
+    {
+    }
+    // Methods
+    size_t index(int x, int y) const { return m_layout.index(x, y); }
+    bool test(int x, int y) const
+    {
+        size_t i = index(x, y);
+        return (m_words[i >> 6] >> (i & 63)) & 1ULL;
+    }
+    void set(int x, int y)
+    {
+        size_t i = index(x, y);
+        m_words.writable(i >> 6) |= 1ULL << (i & 63);
+    }
+    void reset(int x, int y)
+    {
+        size_t i = index(x, y);
+        if (m_words[i >> 6] != 0)
+        {
+            m_words.writable(i >> 6) &= ~(1ULL << (i & 63));
+        }
+    }
+    size_t numTiles() const { return m_words.numPages(); }
+    size_t numAllocatedTiles() const { return m_words.numAllocatedPages(); }
+    size_t memoryUsage() const { return m_words.memoryUsage(); }
+};
+
+// Cost plane, one float per cell in TileLayout order. A tile is allocated on its first cost.
+class CostPlane
+{
+private:
+    TileLayout m_layout;
+    PagedArray<float, 2 * TILE_BITS> m_costs;
+
+public:
+    // Constructor
+    CostPlane() = default;
+    CostPlane(int rows, int cols)
+        : m_layout(rows, cols)
+        , m_costs(m_layout.size())
+    {
+    }
+    // Methods
+    size_t index(int x, int y) const { return m_layout.index(x, y); }
+    float get(int x, int y) const { return m_costs[index(x, y)]; }
+    void add(int x, int y, float cost) { m_costs.writable(index(x, y)) += cost; }
+    size_t numTiles() const { return m_costs.numPages(); }
+    size_t numAllocatedTiles() const { return m_costs.numAllocatedPages(); }
+    size_t memoryUsage() const { return m_costs.memoryUsage(); }
+};
+
+// Nets occupying each key (a cell or a diagonal). The common single owner is kept inline in a paged array, keys
+// with several owners move to an overflow list. A net owns a key once per time it was added.
+class OwnerMap
+{
+private:
+    PagedArray<int32_t, 2 * TILE_BITS> m_owners; // net + 1, 0 = free, -1 = see m_overflow
+    std::unordered_map<int32_t, std::vector<int>> m_overflow;
+
+public:
+    // Constructor
+    OwnerMap() = default;
+    explicit OwnerMap(size_t size)
+        : m_owners(size)
+    {
+    }
+    // Methods
+    void add(int32_t key, int net_id)
+    {
+        int32_t &owner = m_owners.writable(key);
+        if (owner == 0)
+        {
+            owner = net_id + 1;
+            return;
+        }
+        if (owner > 0)
+        {
+            m_overflow[key] = {owner - 1};
+            owner = -1;
+        }
+        m_overflow[key].push_back(net_id);
+    }
+    void remove(int32_t key, int net_id)
+    {
+        int32_t owner = m_owners[key];
+        if (owner == net_id + 1)
+        {
+            m_owners.set(key, 0);
+        }
+        else if (owner < 0)
+        {
+            auto &nets = m_overflow[key];
+            auto it = std::find(nets.begin(), nets.end(), net_id);
+            if (it != nets.end())
+            {
+                nets.erase(it);
+            }
+            if (nets.size() == 1)
+            {
+                m_owners.set(key, nets.front() + 1);
+                m_overflow.erase(key);
+            }
+        }
+    }
+    // Call f(net_id) for every owner of key
+    template <typename F>
+    void forEach(int32_t key, F &&f) const
+    {
+        int32_t owner = m_owners[key];
+        if (owner > 0)
+        {
+            f(owner - 1);
+        }
+        else if (owner < 0)
+        {
+            for (int net_id : m_overflow.at(key))
+            {
+                f(net_id);
+            }
+        }
+    }
+    size_t memoryUsage() const
+    {
+        size_t usage = m_owners.memoryUsage();
+        for (const auto &nets : m_overflow)
+        {
+            usage += sizeof(nets) + nets.second.capacity() * sizeof(int);
+        }
+        return usage;
+    }
+};
+
+// The 8 move directions in counter-clockwise order, so the +-45 degree turns of direction d are (d + 1) & 7 and
+// (d + 7) & 7
+const Point direction_table[8] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+// Return the index of a unit step in direction_table, -1 if it is not a unit step
+inline int directionIndex(const Point &d)
+{
+    static const int lookup[9] = {5, 4, 3, 6, -1, 2, 7, 0, 1}; // (d.x + 1) * 3 + (d.y + 1)
+    if (d.x < -1 || d.x > 1 || d.y < -1 || d.y > 1)
+    {
+        return -1;
+    }
+    return lookup[(d.x + 1) * 3 + (d.y + 1)];
+}
+
+// Inclusive block of grid cells, used for the grid window itself and for per-net search corridors
+struct Window
+{
+    int min_x, min_y, max_x, max_y;
+    bool contains(const Point &p) const { return p.x >= min_x && p.x <= max_x && p.y >= min_y && p.y <= max_y; }
+    // p and its 8 neighbors are inside
+    bool containsInterior(const Point &p) const
+    {
+        return p.x > min_x && p.x < max_x && p.y > min_y && p.y < max_y;
+    }
+    Window intersect(const Window &other) const
+    {
+        return Window{std::max(min_x, other.min_x),
+                      std::max(min_y, other.min_y),
+                      std::min(max_x, other.max_x),
+                      std::min(max_y, other.max_y)};
+    }
+};
+
+// Fine cells a search may enter, given as a set of coarse (global-routing) cells. coarse_x / coarse_y map a fine x / y
+// to its coarse row / column.
+struct Region
+{
+    std::vector<int> coarse_x;
+    std::vector<int> coarse_y;
+    int coarse_cols = 0;
+    std::vector<char> allowed; // coarse row * coarse_cols + coarse column
+    bool contains(const Point &p) const { return allowed[coarse_x[p.x] * coarse_cols + coarse_y[p.y]]; }
+    // p and its 8 neighbors are inside, p has to be in the interior of the grid window
+    bool containsBlock(const Point &p) const
+    {
+        for (int x = p.x - 1; x <= p.x + 1; ++x)
+        {
+            for (int y = p.y - 1; y <= p.y + 1; ++y)
+            {
+                if (!contains(Point(x, y)))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+// Where a search may go: its window (grid window or corridor) and, optionally, a region of coarse cells
+struct SearchBounds
+{
+    Window window;
+    const Region *region = nullptr;
+    SearchBounds(const Window &_window, const Region *_region = nullptr)
+        : window(_window)
+        , region(_region)
+    {
+    }
+    bool contains(const Point &p) const { return window.contains(p) && (region == nullptr || region->contains(p)); }
+    bool containsInterior(const Point &p) const
+    {
+        return window.containsInterior(p) && (region == nullptr || region->containsBlock(p));
+    }
+};
+
+// Fixed-point scale of the integer cost mode, a unit step costs COST_SCALE and a diagonal step COST_SCALE * sqrt(2)
+constexpr double COST_SCALE = 1000.0;
+
+// Step and bend costs of one search, either the plain double costs or the fixed-point costs of the integer mode
+struct StepCosts
+{
+    double straight;
+    double diagonal;
+    double bend;
+    double scale; // multiplier of the cell cost, 0 means use it unscaled
+    double cell(double cost) const { return scale == 0 ? cost : std::round(cost * scale); }
+    double heuristic(const Point &a, const Point &b) const
+    {
+        int dx = abs(a.x - b.x);
+        int dy = abs(a.y - b.y);
+        if (dx > dy)
+        {
+            std::swap(dx, dy);
+        }
+        return diagonal * dx + straight * dy - straight * dx; // same evaluation order as A_Star::heuristic
+    }
+};
+
+// Open list priority, ties on f are broken towards the deeper state
+struct SearchKey
+{
+    double f;
+    double g;
+    bool operator<(const SearchKey &other) const { return f < other.f || (f == other.f && g > other.g); }
+};
+
+// Another net's path met by a new path: the shared cells and whether one of its diagonal steps crosses the new path
+struct Conflict
+{
+    int net_id;
+    std::vector<Point> overlap;
+    bool crossing = false;
+};
+
+// Reusable per-grid search state indexed by search state (cell * 8 + incoming direction). Entries only count when
+// their stamp belongs to the current generation, so starting a new search "clears" every array in O(1). The arrays
+// are paged per tile, so only the tiles a search actually reached take memory.
+class SearchWorkspace
+{
+private:
+    static constexpr int PAGE_BITS = 2 * TILE_BITS + 3;
+    uint32_t m_generation = 0;
+    PagedArray<uint32_t, PAGE_BITS> m_stamps; // == m_generation: cost known, == m_generation + 1: closed
+    PagedArray<double, PAGE_BITS> m_costs;
+    PagedArray<int32_t, PAGE_BITS> m_parents;
+
+public:
+    // Constructor
+    SearchWorkspace() = default;
+    // Accessor
+    size_t size() const { return m_stamps.size(); }
+    bool hasCost(size_t i) const { return m_stamps[i] >= m_generation; }
+    bool isClosed(size_t i) const { return m_stamps[i] == m_generation + 1; }
+    double cost(size_t i) const { return m_costs[i]; }
+    int32_t parent(size_t i) const { return m_parents[i]; }
+    size_t memoryUsage() const { return m_stamps.memoryUsage() + m_costs.memoryUsage() + m_parents.memoryUsage(); }
+    // Methods
+    void begin(size_t size)
+    {
+        if (m_stamps.size() != size)
+        {
+            m_stamps.resize(size);
+            m_costs.resize(size);
+            m_parents.resize(size);
+            m_generation = 0;
+        }
+        m_generation += 2;
+        if (m_generation < 2) // wrapped around, the old stamps are no longer distinguishable
+        {
+            m_stamps.clear();
+            m_generation = 2;
+        }
+    }
+    // Record a (better) cost and the state it was reached from
+    void relax(size_t i, double cost, int32_t parent)
+    {
+        m_costs.set(i, cost);
+        m_parents.set(i, parent);
+        if (m_stamps[i] < m_generation)
+        {
+            m_stamps.set(i, m_generation);
+        }
+    }
+    void close(size_t i) { m_stamps.set(i, m_generation + 1); }
+};
+
+// Search tree of one net kept between its reroutes by the incremental (LPA*) mode: g and rhs of every state the tree
+// has touched, the open list of inconsistent states, and how far the grid's change log was applied
+struct IncrementalTree
+{
+    struct Values
+    {
+        double g = std::numeric_limits<double>::infinity();
+        double rhs = std::numeric_limits<double>::infinity();
+    };
+    // binary heap entry, stale entries are skipped when popped
+    struct Entry
+    {
+        double k1, k2;
+        int32_t state;
+        bool operator<(const Entry &other) const { return k1 > other.k1 || (k1 == other.k1 && k2 > other.k2); }
+    };
+    Point start, goal;
+    int start_direction = 0;
+    bool free_start = false;
+    Window bounds{0, 0, -1, -1};
+    bool integer_cost = false;
+    std::unordered_map<int32_t, Values> values;
+    std::vector<Entry> open;
+    size_t log_position = 0;
+    uint64_t last_used = 0;
+    size_t memoryUsage() const
+    {
+        return values.size() * (sizeof(std::pair<int32_t, Values>) + 2 * sizeof(void *)) +
+               values.bucket_count() * sizeof(void *) + open.capacity() * sizeof(Entry);
+    }
+};
+
+// Exact distance from every cell to one goal over the free cells of the grid window, counting the step costs but not
+// the cell costs or bends. It never overestimates a search to that goal, so A* can use it as its heuristic.
+struct DistanceField
+{
+    ObstaclePlane reached;                      // cells that can reach the goal at all
+    PagedArray<double, 2 * TILE_BITS> distance; // valid where reached is set
+    int searches = 0;                           // searches to the goal so far
+    bool computed = false;
+    uint64_t obstacle_version = 0; // Grid::obstacle_version it was computed at
+    bool integer_cost = false;     // computed with the fixed-point step costs
+    uint64_t last_used = 0;
+    size_t memoryUsage() const { return reached.memoryUsage() + distance.memoryUsage(); }
+};
+
+class RunLengthPath;
+
 class Grid
 {
 public:
     int rows, cols;
-    std::vector<std::vector<int>> grid;
-    std::vector<std::vector<double>> cost_grid;
+    TileLayout layout;
+    ObstaclePlane obstacle_plane;
+    CostPlane cost_plane;
+    OwnerMap cell_owners;     // nets whose path uses the cell
+    OwnerMap diagonal_owners; // nets with a diagonal step inside the 2x2 block, key = lower-left cell * 2 + orientation
+    SearchWorkspace workspace;
+    IndexedHeap<SearchKey> open_list;
+    RadixHeap<int32_t> radix_list;
+    bool integer_cost = false; // search with fixed-point costs on radix_list instead of open_list
+    bool jump_search = false;  // jump over open, zero-cost runs instead of expanding every cell (JPS-style)
+    bool bidirectional = false; // search from both ends and meet in the middle
+    bool hit_window_edge = false; // the last search tried to step outside its grid window or corridor
+    SearchWorkspace reverse_workspace; // backward search of the bidirectional mode
+    IndexedHeap<SearchKey> reverse_open_list;
+    // incremental mode: per-net trees repaired from the cells changed since their last search
+    bool incremental = false;
+    std::vector<int32_t> change_log; // cells whose cost or obstacle changed, recorded while there are trees
+    std::unordered_map<int, IncrementalTree> incremental_trees; // net_id -> tree
+    size_t incremental_budget = size_t(1) << 28; // bytes kept over all trees before least recently used ones go
+    // distance heuristic mode: per-goal distance fields, recomputed after an obstacle was removed
+    bool distance_heuristic = false;
+    std::unordered_map<int32_t, DistanceField> distance_fields; // goal cell -> field
+    size_t distance_field_budget = size_t(1) << 28; // bytes kept over all fields before least recently used ones go
+    uint64_t obstacle_version = 0; // bumped whenever an obstacle is cleared, that can shorten a distance
+    uint64_t cache_clock = 0;      // last_used stamps of the incremental trees and distance fields
     Coordinate bottom_left, top_right;
     double grid_width; // grid_width = grid_height
     const double path_cost = 5.0;
@@ -162,19 +576,149 @@ public:
     {
         rows = (top_right.x() - bottom_left.x()) / grid_width;
         cols = (top_right.y() - bottom_left.y()) / grid_width;
-        grid = std::vector<std::vector<int>>(rows, std::vector<int>(cols, 0));
-        cost_grid = std::vector<std::vector<double>>(rows, std::vector<double>(cols, 0.0));
+        layout = TileLayout(rows, cols);
+        obstacle_plane = ObstaclePlane(rows, cols);
+        cost_plane = CostPlane(rows, cols);
+        cell_owners = OwnerMap(layout.size());
+        diagonal_owners = OwnerMap(layout.size() * 2);
+    }
+    // Accessor
+    bool inBounds(int x, int y) const { return x >= 0 && x < rows && y >= 0 && y < cols; }
+    bool inBounds(const Point &p) const { return inBounds(p.x, p.y); }
+    bool isObstacle(int x, int y) const { return obstacle_plane.test(x, y); }
+    bool isObstacle(const Point &p) const { return obstacle_plane.test(p.x, p.y); }
+    double cost(int x, int y) const { return cost_plane.get(x, y); }
+    double cost(const Point &p) const { return cost_plane.get(p.x, p.y); }
+    void setObstacle(int x, int y)
+    {
+        if (inBounds(x, y))
+        {
+            if (!isObstacle(x, y))
+            {
+                logChange(x, y, true);
+            }
+            obstacle_plane.set(x, y);
+        }
+    }
+    void clearObstacle(const Point &p)
+    {
+        if (inBounds(p))
+        {
+            if (isObstacle(p))
+            {
+                logChange(p.x, p.y, true);
+                ++obstacle_version;
+            }
+            obstacle_plane.reset(p.x, p.y);
+        }
+    }
+    // Record a changed cell for the incremental trees, an obstacle also changes the diagonal moves into its neighbors
+    void logChange(int x, int y, bool with_neighbors = false)
+    {
+        if (!incremental || incremental_trees.empty())
+        {
+            return;
+        }
+        const int reach = with_neighbors ? 1 : 0;
+        for (int i = x - reach; i <= x + reach; ++i)
+        {
+            for (int j = y - reach; j <= y + reach; ++j)
+            {
+                if (inBounds(i, j))
+                {
+                    change_log.push_back(cellIndex(Point(i, j)));
+                }
+            }
+        }
+    }
+    int32_t cellIndex(const Point &p) const { return layout.index(p.x, p.y); }
+    Point cellPoint(int32_t cell) const { return layout.point(cell); }
+    size_t numStates() const { return layout.size() * 8; }
+    Window window() const { return Window{0, 0, rows - 1, cols - 1}; }
+    // A cell is clear when it and its 8 neighbors are inside bounds, free and carry no cost
+    bool isClear(const Point &p, const SearchBounds &bounds) const
+    {
+        if (!bounds.containsInterior(p))
+        {
+            return false;
+        }
+        for (int x = p.x - 1; x <= p.x + 1; ++x)
+        {
+            for (int y = p.y - 1; y <= p.y + 1; ++y)
+            {
+                if (isObstacle(x, y) || cost(x, y) != 0)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    int32_t stateIndex(int32_t cell, int direction) const { return cell * 8 + direction; }
+    int toCellX(double x) const { return std::floor((x - bottom_left.x()) / grid_width); }
+    int toCellY(double y) const { return std::floor((y - bottom_left.y()) / grid_width); }
+    Point toPoint(const Coordinate &c) const { return Point(toCellX(c.x()), toCellY(c.y())); }
+    // Cell of this grid that covers the same area as cell p of other (both grids share grid_width and alignment)
+    Point fromGrid(const Grid &other, const Point &p) const
+    {
+        return Point(p.x + std::lround((other.bottom_left.x() - bottom_left.x()) / grid_width),
+                     p.y + std::lround((other.bottom_left.y() - bottom_left.y()) / grid_width));
     }
+    void copyFrom(const Grid &other);
     std::vector<Point> get_valid_directions(const Point &prev, const Point &current);
-    std::vector<Point> a_star_search(const Coordinate &start, const Coordinate &goal, const Point &parent);
-    std::vector<Point> a_star_search(Point start, Point goal, const Point &parent);
+    std::vector<Point> a_star_search(const Coordinate &start,
+                                     const Coordinate &goal,
+                                     const Point &parent,
+                                     const std::optional<Window> &corridor = std::nullopt,
+                                     const Region *region = nullptr);
+    std::vector<Point> a_star_search(Point start,
+                                     Point goal,
+                                     const Point &parent,
+                                     const std::optional<Window> &corridor = std::nullopt,
+                                     const Region *region = nullptr);
+    template <typename OpenList>
+    std::vector<Point>
+    a_star_search(Point start, Point goal, const Point &parent, const SearchBounds &bounds, OpenList queue);
+    std::vector<Point>
+    bidirectional_a_star_search(Point start, Point goal, const Point &parent, const SearchBounds &bounds);
+    // LPA* on the same states as a_star_search, keeping the tree of net_id for its next reroute. The tree covers the
+    // whole corridor, region only bounds the plain A* used when the incremental mode is off.
+    std::vector<Point> incremental_search(const int net_id,
+                                          const Coordinate &start,
+                                          const Coordinate &goal,
+                                          const Point &parent_direction,
+                                          const std::optional<Window> &corridor = std::nullopt,
+                                          const Region *region = nullptr);
+    std::vector<Point> incremental_search(const int net_id,
+                                          Point start,
+                                          Point goal,
+                                          const Point &parent,
+                                          const std::optional<Window> &corridor,
+                                          const Region *region = nullptr);
+    // Distance field to goal, computed from its second search on and cached, nullptr unless distance_heuristic is set
+    const DistanceField *distanceField(const Point &goal);
+    StepCosts stepCosts() const
+    {
+        if (integer_cost)
+        {
+            return StepCosts{COST_SCALE, std::round(COST_SCALE * sqrt(2)), bend_cost * COST_SCALE, COST_SCALE};
+        }
+        return StepCosts{1, sqrt(2), bend_cost, 0};
+    }
     std::vector<Segment> points2segments(const std::vector<Point> &points, const int &net_id, const int &layer);
+    // One segment per run, from cell center to cell center
+    std::vector<Segment> runs2segments(const RunLengthPath &path, const int &net_id, const int &layer);
     std::vector<Point> segments2points(const std::vector<Segment> &segments);
     bool isOverlap(const std::vector<Point> &path_1, const std::vector<Point> &path_2);
     bool isCrossing(const std::vector<Point> &path_1, const std::vector<Point> &path_2);
     std::vector<Point> overlapPath(const std::vector<Point> &path_1, const std::vector<Point> &path_2);
     std::vector<Point> crossingPath(const std::vector<Point> &path_1, const std::vector<Point> &path_2);
     void ripUpPath(const std::vector<Point> &path);
+    int32_t diagonalIndex(const Point &from, const Point &to) const;
+    void addPathOwner(const std::vector<Point> &path, const int net_id);
+    void removePathOwner(const std::vector<Point> &path, const int net_id);
+    // Paths of other nets sharing a cell with path or crossing one of its diagonals, in the order path meets them
+    std::vector<Conflict> conflicts(const std::vector<Point> &path, const int net_id) const;
     void addCost(const Point &point, double cost);
     void addPathCost(const std::vector<Point> &path);
     void addHistoryCost(const std::vector<Point> &path);
@@ -187,6 +731,81 @@ public:
     void addObstacle(const Coordinate &obstacle);
 };
 
+// Global-routing cells laid over a Grid. Coarse cell (i, j) covers [left + i * width, left + (i + 1) * width) as in
+// DataManager::findCell, a fine cell belongs to the coarse cell of its center. Cells are addressed with their global
+// (findCell) index. The capacity of a cell is the number of its free fine cells per fine cell of width, roughly the
+// tracks through it, and its usage the number of routed paths passing it.
+class CoarseGrid
+{
+public:
+    Point origin; // global index of the coarse cell holding fine cell (0, 0)
+    int rows = 0, cols = 0;
+    Region lookup; // fine to coarse mapping shared by every region, allowed is left empty
+    std::vector<double> capacity;
+    std::vector<int> usage;
+    const double overflow_cost = 8.0; // per step into a full cell, a detour of a few cells is cheaper
+    // Constructor
+    CoarseGrid(const Grid &grid, const std::pair<double, double> &left_bottom, double width, double height);
+    // Accessor
+    bool inBounds(const Point &cell) const
+    {
+        return cell.x >= origin.x && cell.x < origin.x + rows && cell.y >= origin.y && cell.y < origin.y + cols;
+    }
+    int index(const Point &cell) const { return (cell.x - origin.x) * cols + (cell.y - origin.y); }
+    Point cellOf(const Point &fine) const
+    {
+        return Point(origin.x + lookup.coarse_x[fine.x], origin.y + lookup.coarse_y[fine.y]);
+    }
+    // Methods
+    // Cheapest 8-connected coarse path between the cells of two fine points, a step costs more the fuller the cell
+    // it enters is, and cells without free fine cells are blocked. Empty if there is none.
+    std::vector<Point> route(const Point &from, const Point &to) const;
+    // Coarse cells a fine path passes, in order
+    std::vector<Point> cellsOf(const std::vector<Point> &path) const;
+    void addUsage(const std::vector<Point> &cells, int delta);
+    // The coarse cells and every cell up to margin cells away from them
+    Region region(const std::vector<Point> &cells, int margin) const;
+};
+
+// Path of unit steps stored as its first point and runs of steps in one direction (direction_table index, length)
+class RunLengthPath
+{
+public:
+    Point start;
+    std::vector<std::pair<uint8_t, uint32_t>> runs;
+    size_t num_points = 0;
+    // Constructor
+    RunLengthPath() = default;
+    explicit RunLengthPath(const std::vector<Point> &points);
+    // Accessor
+    bool empty() const { return num_points == 0; }
+    size_t size() const { return num_points; }
+    size_t memoryUsage() const { return runs.capacity() * sizeof(runs[0]); }
+    // Methods
+    std::vector<Point> points() const;
+    template <typename F>
+    void forEachPoint(F &&f) const
+    {
+        if (num_points == 0)
+        {
+            return;
+        }
+        Point p = start;
+        f(p);
+        for (const auto &run : runs)
+        {
+            const Point &d = direction_table[run.first];
+            for (uint32_t i = 0; i < run.second; ++i)
+            {
+                p = p + d;
+                f(p);
+            }
+        }
+    }
+    // Drop the first and the last point
+    void trim();
+};
+
 class PathInfo
 {
 public:
@@ -194,16 +813,17 @@ public:
     Coordinate end;
     int net_id;
     int layer;
-    std::vector<Point> points_path;
+    RunLengthPath path;
     PathInfo() = default;
     PathInfo(const Coordinate &s, const Coordinate &e, const int &ni, const int &l, const std::vector<Point> &pp)
         : start(s)
         , end(e)
         , net_id(ni)
         , layer(l)
-        , points_path(pp)
+        , path(pp)
     {
     }
+    std::vector<Point> points() const { return path.points(); }
 };
 } // namespace A_Star
 
@@ -0,0 +1,244 @@
+#ifndef HEAP_HPP
+#define HEAP_HPP
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "paged_array.hpp"
+
+// Indexed d-ary min-heap over integer keys in [0, capacity). Every key is stored at most once and its position is
+// tracked, so a better priority is applied in place (decrease-key) instead of pushing a duplicate entry.
+// Priority only needs operator<. Positions are paged by 2^15 keys, so a huge, sparsely used key space stays cheap.
+template <typename Priority, int D = 4>
+class IndexedHeap
+{
+    static_assert(D >= 2, "IndexedHeap arity must be at least 2");
+
+private:
+    struct Entry
+    {
+        int32_t key;
+        Priority priority;
+    };
+    std::vector<Entry> m_entries;
+    PagedArray<int32_t, 15> m_positions; // key -> index in m_entries + 1, 0 if not in heap
+
+    void place(size_t index, const Entry &entry)
+    {
+        m_entries[index] = entry;
+        m_positions.set(entry.key, static_cast<int32_t>(index) + 1);
+    }
+    void siftUp(size_t index)
+    {
+        Entry entry = m_entries[index];
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / D;
+            if (!(entry.priority < m_entries[parent].priority))
+            {
+                break;
+            }
+            place(index, m_entries[parent]);
+            index = parent;
+        }
+        place(index, entry);
+    }
+    void siftDown(size_t index)
+    {
+        Entry entry = m_entries[index];
+        const size_t size = m_entries.size();
+        while (true)
+        {
+            size_t first = index * D + 1;
+            if (first >= size)
+            {
+                break;
+            }
+            size_t last = std::min(first + D, size);
+            size_t best = first;
+            for (size_t child = first + 1; child < last; ++child)
+            {
+                if (m_entries[child].priority < m_entries[best].priority)
+                {
+                    best = child;
+                }
+            }
+            if (!(m_entries[best].priority < entry.priority))
+            {
+                break;
+            }
+            place(index, m_entries[best]);
+            index = best;
+        }
+        place(index, entry);
+    }
+
+public:
+    // Constructor
+    IndexedHeap() = default;
+    explicit IndexedHeap(size_t capacity) { reset(capacity); }
+    // Accessor
+    bool empty() const { return m_entries.empty(); }
+    size_t size() const { return m_entries.size(); }
+    size_t capacity() const { return m_positions.size(); }
+    bool contains(int32_t key) const { return m_positions[key] > 0; }
+    int32_t top() const { return m_entries.front().key; }
+    const Priority &topPriority() const { return m_entries.front().priority; }
+    const Priority &priority(int32_t key) const { return m_entries[m_positions[key] - 1].priority; }
+    size_t memoryUsage() const { return m_entries.capacity() * sizeof(Entry) + m_positions.memoryUsage(); }
+    // Methods
+    // Empty the heap and make room for keys in [0, capacity), only the keys still queued are touched when the
+    // capacity is unchanged
+    void reset(size_t capacity)
+    {
+        if (m_positions.size() != capacity)
+        {
+            m_positions.resize(capacity);
+        }
+        else
+        {
+            for (const auto &entry : m_entries)
+            {
+                m_positions.set(entry.key, 0);
+            }
+        }
+        m_entries.clear();
+    }
+    void push(int32_t key, const Priority &priority)
+    {
+        if (contains(key))
+        {
+            throw std::runtime_error("IndexedHeap push: key " + std::to_string(key) + " is already queued");
+        }
+        m_entries.push_back(Entry{key, priority});
+        siftUp(m_entries.size() - 1);
+    }
+    // Lower the priority of a queued key, a priority that is not better is ignored
+    void decrease(int32_t key, const Priority &priority)
+    {
+        size_t index = m_positions[key] - 1;
+        if (!(priority < m_entries[index].priority))
+        {
+            return;
+        }
+        m_entries[index].priority = priority;
+        siftUp(index);
+    }
+    void pushOrDecrease(int32_t key, const Priority &priority)
+    {
+        if (contains(key))
+        {
+            decrease(key, priority);
+        }
+        else
+        {
+            push(key, priority);
+        }
+    }
+    int32_t pop()
+    {
+        int32_t key = m_entries.front().key;
+        m_positions.set(key, 0);
+        Entry last = m_entries.back();
+        m_entries.pop_back();
+        if (!m_entries.empty())
+        {
+            place(0, last);
+            siftDown(0);
+        }
+        return key;
+    }
+};
+
+// Monotone radix heap over unsigned integer keys (e.g. fixed-point A* f values with a consistent heuristic). A pushed
+// key must not be smaller than the last popped key. Keys are kept in buckets by the highest bit that differs from the
+// last popped key, so push is O(1) and pop is O(log C) amortized. There is no decrease-key, a better key is pushed
+// again and the caller skips the stale entry.
+template <typename Value>
+class RadixHeap
+{
+private:
+    static constexpr int NUM_BUCKETS = 65;
+    std::array<std::vector<std::pair<uint64_t, Value>>, NUM_BUCKETS> m_buckets;
+    uint64_t m_last = 0;
+    size_t m_size = 0;
+
+    static int bucketIndex(uint64_t key, uint64_t last) { return key == last ? 0 : 64 - __builtin_clzll(key ^ last); }
+    // Make bucket 0 non-empty by moving the smallest non-empty bucket down around its minimum key
+    void refill()
+    {
+        if (!m_buckets[0].empty())
+        {
+            return;
+        }
+        int i = 1;
+        while (m_buckets[i].empty())
+        {
+            ++i;
+        }
+        uint64_t new_last = m_buckets[i].front().first;
+        for (const auto &entry : m_buckets[i])
+        {
+            new_last = std::min(new_last, entry.first);
+        }
+        m_last = new_last;
+        for (const auto &entry : m_buckets[i])
+        {
+            m_buckets[bucketIndex(entry.first, m_last)].push_back(entry);
+        }
+        m_buckets[i].clear();
+    }
+
+public:
+    // Constructor
+    RadixHeap() = default;
+    // Accessor
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+    size_t memoryUsage() const
+    {
+        size_t usage = 0;
+        for (const auto &bucket : m_buckets)
+        {
+            usage += bucket.capacity() * sizeof(std::pair<uint64_t, Value>);
+        }
+        return usage;
+    }
+    // Methods
+    void clear()
+    {
+        for (auto &bucket : m_buckets)
+        {
+            bucket.clear();
+        }
+        m_last = 0;
+        m_size = 0;
+    }
+    void push(uint64_t key, const Value &value)
+    {
+        if (key < m_last)
+        {
+            throw std::runtime_error("RadixHeap push: key " + std::to_string(key) + " is below the last popped key " +
+                                     std::to_string(m_last));
+        }
+        m_buckets[bucketIndex(key, m_last)].emplace_back(key, value);
+        ++m_size;
+    }
+    uint64_t topKey()
+    {
+        refill();
+        return m_last;
+    }
+    Value pop()
+    {
+        refill();
+        Value value = m_buckets[0].back().second;
+        m_buckets[0].pop_back();
+        --m_size;
+        return value;
+    }
+};
+
+#endif
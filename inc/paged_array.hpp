@@ -0,0 +1,73 @@
+#ifndef PAGED_ARRAY_HPP
+#define PAGED_ARRAY_HPP
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Fixed-size array split into pages of 2^PAGE_BITS entries. Every page starts out as one shared, read-only page of
+// zeros and gets its own storage on the first write, so memory follows the entries that were actually written.
+// T has to be a type whose value-initialized value is the "empty" value (0 for arithmetic types).
+template <typename T, int PAGE_BITS>
+class PagedArray
+{
+public:
+    static constexpr size_t PAGE_SIZE = size_t(1) << PAGE_BITS;
+    static constexpr size_t PAGE_MASK = PAGE_SIZE - 1;
+
+private:
+    size_t m_size = 0;
+    std::vector<T *> m_pages;                  // every entry is emptyPage() or one of m_storage
+    std::vector<std::unique_ptr<T[]>> m_storage;
+
+    static T *emptyPage()
+    {
+        static const std::vector<T> page(PAGE_SIZE);
+        // never written through, writable() replaces it before the first write
+        return const_cast<T *>(page.data());
+    }
+
+public:
+    // Constructor
+    PagedArray() = default;
+    explicit PagedArray(size_t size) { resize(size); }
+    // Accessor
+    size_t size() const { return m_size; }
+    size_t numPages() const { return m_pages.size(); }
+    size_t numAllocatedPages() const { return m_storage.size(); }
+    bool isAllocated(size_t page) const { return m_pages[page] != emptyPage(); }
+    T operator[](size_t i) const { return m_pages[i >> PAGE_BITS][i & PAGE_MASK]; }
+    size_t memoryUsage() const
+    {
+        return m_pages.capacity() * sizeof(T *) + m_storage.capacity() * sizeof(std::unique_ptr<T[]>) +
+               m_storage.size() * PAGE_SIZE * sizeof(T);
+    }
+    // Methods
+    // Drop every page and cover size entries, all of them read as empty again
+    void resize(size_t size)
+    {
+        m_size = size;
+        m_pages.assign((size + PAGE_MASK) >> PAGE_BITS, emptyPage());
+        m_storage.clear();
+    }
+    // Every entry reads as empty again, allocated pages are kept and zeroed
+    void clear()
+    {
+        for (auto &page : m_storage)
+        {
+            std::fill(page.get(), page.get() + PAGE_SIZE, T());
+        }
+    }
+    T &writable(size_t i)
+    {
+        T *&page = m_pages[i >> PAGE_BITS];
+        if (page == emptyPage())
+        {
+            m_storage.emplace_back(new T[PAGE_SIZE]());
+            page = m_storage.back().get();
+        }
+        return page[i & PAGE_MASK];
+    }
+    void set(size_t i, const T &value) { writable(i) = value; }
+};
+
+#endif
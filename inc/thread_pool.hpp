@@ -0,0 +1,223 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fixed-size pool of worker threads running submitted tasks in FIFO order. The destructor finishes the queued tasks
+// and joins the workers. An exception thrown by a task is rethrown by get() on its future.
+class ThreadPool
+{
+private:
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+                if (m_tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    // Constructor, 0 threads means one per hardware thread
+    explicit ThreadPool(size_t num_threads = 0)
+    {
+        if (num_threads == 0)
+        {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            m_workers.emplace_back([this] { work(); });
+        }
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        for (auto &worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+    // Accessor
+    size_t size() const { return m_workers.size(); }
+    // Methods
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F &&f)
+    {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(f));
+        auto result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace_back([task] { (*task)(); });
+        }
+        m_condition.notify_one();
+        return result;
+    }
+};
+
+// Pool of worker threads with a task deque each. A worker runs its newest task first and, once its deque is empty,
+// steals the oldest task of another worker, so a few long tasks do not hold up the short ones queued behind them.
+// Tasks submitted by a worker go to its own deque, the others are dealt round-robin. Like ThreadPool, the destructor
+// finishes the queued tasks and joins the workers, and get() on a future rethrows the exception of its task.
+class WorkStealingPool
+{
+private:
+    struct Queue
+    {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex; // guards m_pending and m_stop
+    std::condition_variable m_condition;
+    size_t m_pending = 0; // tasks queued and not claimed by a worker yet
+    bool m_stop = false;
+    std::atomic<size_t> m_next{0};
+
+    // The pool and the index of the worker running on this thread
+    static std::pair<const WorkStealingPool *, size_t> &currentWorker()
+    {
+        thread_local std::pair<const WorkStealingPool *, size_t> worker(nullptr, 0);
+        return worker;
+    }
+    bool take(size_t index, std::function<void()> &task)
+    {
+        {
+            Queue &own = *m_queues[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < m_queues.size(); ++i)
+        {
+            Queue &victim = *m_queues[(index + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+    void work(size_t index)
+    {
+        currentWorker() = {this, index};
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this] { return m_stop || m_pending > 0; });
+                if (m_pending == 0)
+                {
+                    return;
+                }
+                --m_pending;
+            }
+            // the claimed task sits in some deque, another worker may only take it after claiming one of its own
+            std::function<void()> task;
+            while (!take(index, task))
+            {
+                std::this_thread::yield();
+            }
+            task();
+        }
+    }
+
+public:
+    // Constructor, 0 threads means one per hardware thread
+    explicit WorkStealingPool(size_t num_threads = 0)
+    {
+        if (num_threads == 0)
+        {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            m_queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            m_workers.emplace_back([this, i] { work(i); });
+        }
+    }
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        for (auto &worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+    // Accessor
+    size_t size() const { return m_workers.size(); }
+    // Methods
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F &&f)
+    {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(f));
+        auto result = task->get_future();
+        auto [pool, index] = currentWorker();
+        if (pool != this)
+        {
+            index = m_next++ % m_queues.size();
+        }
+        {
+            Queue &queue = *m_queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.emplace_back([task] { (*task)(); });
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_pending;
+        }
+        m_condition.notify_one();
+        return result;
+    }
+};
+
+#endif
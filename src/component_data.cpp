@@ -6,10 +6,12 @@
 #include "io.hpp"
 #include "log.hpp"
 #include "math.hpp"
+#include "thread_pool.hpp"
 #include <cmath>
 #include <deque>
 #include <fstream>
 #include <limits>
+#include <numeric>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -572,86 +574,209 @@ void DataManager::preprocess_ER()
     }
 }
 
-void DataManager::DDR2DDR()
+void DataManager::escapeRouting(bool ddr, bool cpu)
 {
-    std::shared_ptr<GraphManager> graph_manager;
-    for (auto comp_pair : m_components)
+    // each component only writes its own router and reads the rest, the DDRs go first as in the serial order
+    std::vector<std::shared_ptr<Component>> comps;
+    for (bool is_cpu : {false, true})
     {
-        auto comp = comp_pair.second;
-        if (comp->is_cpu())
-            continue;
-        long flow = 0;
-        int expand = 2;
-        int maximum_layer = 3;
-        std::vector<std::unordered_set<int>> pinsets(1);
-        // all pins
-        for (size_t i = 0; i < comp->pins().size(); i++)
+        for (auto &comp_pair : m_components)
+        {
+            if (comp_pair.second->is_cpu() == is_cpu && (is_cpu ? cpu : ddr))
+            {
+                comps.push_back(comp_pair.second);
+            }
+        }
+    }
+    std::vector<std::vector<std::string>> logs(comps.size());
+    std::vector<std::future<void>> results;
+    {
+        WorkStealingPool pool(m_escape_threads);
+        for (size_t i = 0; i < comps.size(); ++i)
+        {
+            results.push_back(pool.submit(
+                [&, i]
+                {
+                    if (comps[i]->is_cpu())
+                    {
+                        CPU2DDR(*comps[i]);
+                    }
+                    else
+                    {
+                        DDR2DDR(*comps[i], logs[i]);
+                    }
+                }));
+        }
+    }
+    for (size_t i = 0; i < comps.size(); ++i)
+    {
+        for (const auto &line : logs[i])
         {
-            pinsets[0].insert(comp->pins().at(i)->net_id());
+            utils::printlog(line);
         }
+        results[i].get();
+    }
+}
+
+void DataManager::DDR2DDR(Component &comp, std::vector<std::string> &log)
+{
+    std::shared_ptr<GraphManager> graph_manager;
+    long flow = 0;
+    int expand = 2;
+    int maximum_layer = 3;
+    std::vector<std::unordered_set<int>> pinsets(1);
+    // all pins
+    for (size_t i = 0; i < comp.pins().size(); i++)
+    {
+        pinsets[0].insert(comp.pins().at(i)->net_id());
+    }
 
+    long num_pins = comp.pins().size();
+    auto logAttempt = [&](const std::pair<int, int> &configuration)
+    {
+        log.push_back("DDR: " + comp.comp_name() + " expand: " + std::to_string(configuration.first) +
+                      " maximum_layer: " + std::to_string(configuration.second));
+    };
+    // the configurations in the order they are tried, expand runs up to 5 before another layer is added
+    auto nextConfiguration = [&]()
+    {
+        std::pair<int, int> configuration(expand++, maximum_layer);
+        if (expand > 5)
+        {
+            maximum_layer++;
+            expand = 0;
+        }
+        return configuration;
+    };
+    if (!m_parallel_escape_search)
+    {
+        std::shared_ptr<GraphManager> previous_manager;
         do
         {
+            auto configuration = nextConfiguration();
             graph_manager = std::make_shared<GraphManager>();
-            graph_manager->DDR2DDRInit(*this, *comp, expand++, maximum_layer);
-            flow = 0;
-            for (auto ps : pinsets)
+            flow = escapeDDR(*graph_manager,
+                             comp,
+                             pinsets,
+                             configuration.first,
+                             configuration.second,
+                             previous_manager.get());
+            previous_manager = graph_manager;
+            logAttempt(configuration);
+        } while (flow != num_pins);
+    }
+    else
+    {
+        // a wave of configurations at a time, once one reaches full flow the later ones can not win any more
+        ThreadPool pool(m_escape_threads);
+        graph_manager = nullptr;
+        while (!graph_manager)
+        {
+            std::vector<std::pair<int, int>> configurations;
+            for (size_t i = 0; i < pool.size(); ++i)
+            {
+                configurations.push_back(nextConfiguration());
+            }
+            std::vector<std::shared_ptr<GraphManager>> managers(configurations.size());
+            std::vector<std::future<long>> results;
+            std::atomic<size_t> winner(configurations.size());
+            for (size_t i = 0; i < configurations.size(); ++i)
+            {
+                managers[i] = std::make_shared<GraphManager>();
+                results.push_back(pool.submit(
+                    [&, i]
+                    {
+                        auto cancelled = [&winner, i] { return winner.load() < i; };
+                        if (cancelled())
+                        {
+                            return 0L;
+                        }
+                        long attempt_flow = escapeDDR(*managers[i],
+                                                      comp,
+                                                      pinsets,
+                                                      configurations[i].first,
+                                                      configurations[i].second,
+                                                      nullptr,
+                                                      cancelled);
+                        size_t current = winner.load();
+                        while (attempt_flow == num_pins && i < current &&
+                               !winner.compare_exchange_weak(current, i))
+                        {
+                        }
+                        return attempt_flow;
+                    }));
+            }
+            // every attempt refers to this wave, let them all finish before reading them in order
+            for (auto &result : results)
             {
-                graph_manager->addSource2Pins(*comp, ps);
-                flow += graph_manager->minCostMaxFlow();
-                graph_manager->fixFlowResults();
+                result.wait();
             }
-            utils::printlog("DDR: " + comp->comp_name() + " expand: " + std::to_string(expand - 1) +
-                            " maximum_layer: " + std::to_string(maximum_layer));
-            if (expand > 5)
+            for (size_t i = 0; i < configurations.size() && !graph_manager; ++i)
             {
-                maximum_layer++;
-                expand = 0;
+                flow = results[i].get();
+                logAttempt(configurations[i]);
+                if (flow == num_pins)
+                {
+                    graph_manager = managers[i];
+                }
             }
-        } while (flow != (long)comp->pins().size());
-        graph_manager->restoreFlowResults();
-        comp->bounding_box() = graph_manager->DDR2DDR(comp->router());
-        comp->router()->setViaNetId();
-        comp->router()->setSegmentNetId();
+        }
     }
+    graph_manager->restoreFlowResults();
+    comp.bounding_box() = graph_manager->DDR2DDR(comp.router());
+    comp.router()->setNetId();
 }
 
-void DataManager::CPU2DDR()
+long DataManager::escapeDDR(GraphManager &graph_manager,
+                            Component &comp,
+                            const std::vector<std::unordered_set<int>> &pinsets,
+                            int expand,
+                            int maximum_layer,
+                            const GraphManager *previous,
+                            const std::function<bool()> &cancelled)
 {
-    std::shared_ptr<GraphManager> graph_manager;
-    double bump_ball_radius = 7.5;
-    double flow;
-
-    for (auto comp_pair : m_components)
+    graph_manager.DDR2DDRInit(*this, comp, expand, maximum_layer);
+    long flow = 0;
+    for (auto ps : pinsets)
     {
-        auto comp = comp_pair.second;
-        if (comp->is_cpu())
+        long num_pins = graph_manager.addSource2Pins(comp, ps);
+        // 先从上一次尝试的流暖启动求最大流, 逃不出全部 pin 时不用再解最小费用流
+        long max_flow = graph_manager.maxFlow(previous);
+        if (max_flow < num_pins || (cancelled && cancelled()))
         {
-            graph_manager = std::make_shared<GraphManager>();
-            graph_manager->CPU2DDRInit(
-                *this, *comp, m_wire_spacing, m_wire_width, bump_ball_radius, m_cpu_escape_boundary);
-            flow = graph_manager->minCostMaxFlow();
+            return flow + max_flow;
+        }
+        flow += graph_manager.minCostMaxFlow();
+        graph_manager.fixFlowResults();
+    }
+    return flow;
+}
+
+void DataManager::CPU2DDR(Component &comp)
+{
+    double bump_ball_radius = 7.5;
+    auto graph_manager = std::make_shared<GraphManager>();
+    graph_manager->CPU2DDRInit(*this, comp, m_wire_spacing, m_wire_width, bump_ball_radius, m_cpu_escape_boundary);
+    double flow = graph_manager->minCostMaxFlow();
 #ifdef VERBOSE
-            // std::cout << "CPU2DDR: " << comp->comp_name() << std::endl;
-            // std::cout << "flow = " << flow << std::endl;
-            // std::cout << "#pins = " << (long)comp->pins().size() << std::endl;
+    // std::cout << "CPU2DDR: " << comp.comp_name() << std::endl;
+    // std::cout << "flow = " << flow << std::endl;
+    // std::cout << "#pins = " << (long)comp.pins().size() << std::endl;
 #endif
-            // escape routing
-            graph_manager->CPU2DDR(comp->router(), *comp, m_cpu_escape_boundary);
-            try
-            {
-                if (flow != (long)comp->pins().size())
-                {
-                    throw std::runtime_error("Error: CPU2DDR flow != #pins");
-                }
-            }
-            catch (const std::runtime_error &e)
-            {
+    // escape routing
+    graph_manager->CPU2DDR(comp.router(), comp, m_cpu_escape_boundary);
+    try
+    {
+        if (flow != (long)comp.pins().size())
+        {
+            throw std::runtime_error("Error: CPU2DDR flow != #pins");
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
 #ifdef VERBOSE
-                std::cout << e.what() << std::endl;
+        std::cout << e.what() << std::endl;
 #endif
-            }
-        }
     }
 }
 
@@ -1152,45 +1277,68 @@ void DataManager::createGrid(const std::vector<std::pair<Coordinate, int>> &cpu_
         max_y = std::max(max_y, ep.first.y());
     }
 
+    // routing window = bounding box + margin, snapped to multiples of pitch from the origin so the cell centers stay
+    // where a grid over the whole board would put them
+    const double margin = m_grid_margin * pitch;
+    const double left = std::floor((min_x - margin) / pitch) * pitch;
+    const double bottom = std::floor((min_y - margin) / pitch) * pitch;
+    const double right = left + (std::ceil((max_x + margin - left) / pitch) + 0.5) * pitch;
+    const double top = bottom + (std::ceil((max_y + margin - bottom) / pitch) + 0.5) * pitch;
     for (const auto &layer : layers)
     {
-        // m_grids[layer] =
-        // std::make_shared<A_Star::Grid>(Coordinate{min_x, min_y, layer}, Coordinate{max_x, max_y, layer}, pitch);
-        m_grids[layer] =
-            std::make_shared<A_Star::Grid>(Coordinate{0, 0, layer}, Coordinate{20000.0, 20000.0, layer}, pitch);
+        m_grids[layer] = makeGrid(Coordinate{left, bottom, layer}, Coordinate{right, top, layer}, pitch);
     }
 }
 
+std::shared_ptr<A_Star::Grid>
+DataManager::makeGrid(const Coordinate &bottom_left, const Coordinate &top_right, const double &pitch) const
+{
+    auto grid = std::make_shared<A_Star::Grid>(bottom_left, top_right, pitch);
+    grid->integer_cost = m_integer_cost_search;
+    grid->jump_search = m_jump_point_search;
+    grid->bidirectional = m_bidirectional_search;
+    grid->incremental = m_incremental_search;
+    grid->distance_heuristic = m_distance_heuristic;
+    return grid;
+}
+
+A_Star::Point DataManager::growGrid(const int layer, const int margin)
+{
+    auto old_grid = m_grids.at(layer);
+    const double pitch = old_grid->grid_width;
+    const Coordinate &old_bottom_left = old_grid->bottom_left;
+    Coordinate bottom_left(old_bottom_left.x() - margin * pitch, old_bottom_left.y() - margin * pitch, layer);
+    Coordinate top_right(old_bottom_left.x() + (old_grid->rows + margin + 0.5) * pitch,
+                         old_bottom_left.y() + (old_grid->cols + margin + 0.5) * pitch,
+                         layer);
+    m_grids.at(layer) = makeGrid(bottom_left, top_right, pitch);
+    // obstacles for the new border, the old window keeps its own state (cleared escape points, path and history cost)
+    markExistingObstacles(layer);
+    m_grids[layer]->copyFrom(*old_grid);
+    return m_grids[layer]->fromGrid(*old_grid, A_Star::Point(0, 0));
+}
+
 void DataManager::addPointsPath2Segments(A_Star::Grid &grid,
-                                         std::vector<A_Star::Point> &point_path,
+                                         A_Star::RunLengthPath path,
                                          const int net_id,
                                          const int layer,
                                          const Coordinate &start,
                                          const Coordinate &end)
 {
-    // remove the head and tail of point_path for not align with start and end
-    point_path.erase(point_path.begin());
-    point_path.pop_back();
-    auto segments = grid.points2segments(point_path, net_id, layer);
-    // add on grid segments
-    for (const auto &seg : segments)
-    {
-        m_area_router->addSegment(seg);
-    }
+    // remove the head and tail of the path for not align with start and end
+    path.trim();
+    // one segment per run of equal steps instead of one per grid step
+    auto segments = grid.runs2segments(path, net_id, layer);
     // add start to first point and last point to end
     // add start to first point(DDR escape point to first point of the path)
     std::vector<Segment> path_to_start = Segment::generatePath(start, segments.front().start(), net_id);
-    for (const auto &seg : path_to_start)
-    {
-        m_area_router->addSegment(seg);
-    }
     // add last point to end(last point of the path to CPU escape point)
     std::vector<Segment> path_to_end =
         Segment::generatePath(segments.back().end(), Coordinate(end.x(), end.y(), layer), net_id); // end.z() = 0
-    for (const auto &seg : path_to_end)
-    {
-        m_area_router->addSegment(seg);
-    }
+    // on grid segments first, the whole net is joined at once
+    segments.insert(segments.end(), path_to_start.begin(), path_to_start.end());
+    segments.insert(segments.end(), path_to_end.begin(), path_to_end.end());
+    m_area_router->addSegments(segments);
 }
 
 bool DataManager::CPU2DDR_A_Star(const std::vector<std::pair<Coordinate, int>> &cpu_ep,
@@ -1201,16 +1349,23 @@ bool DataManager::CPU2DDR_A_Star(const std::vector<std::pair<Coordinate, int>> &
     // ddr_ep is start point, cpu_ep is end point using net_id to find the pair
     // and the using layer is depends on ddr_ep layer
     std::unordered_map<int, RouteCandidate> route_information; // (net_id, route candidate)
-    std::unordered_map<int, std::deque<RouteCandidate>> route_candidates; // (layer, deque<route candidates>)
-    std::unordered_set<int> layers; // store all layers, later will route layer by layer
-    std::unordered_map<int, A_Star::PathInfo> paths; // store all paths, (net_id, path)
-    int num_routes = 0;
+    std::unordered_map<int, RerouteQueue> route_candidates; // (layer, queue of route candidates)
+    std::set<int> layers; // store all layers, every layer is routed on its own grid
+    std::atomic<int> num_routes{0};
+    int num_nets = 0;
+    for (const auto &d_ep : ddr_ep)
+    {
+        num_nets = std::max(num_nets, d_ep.second + 1);
+    }
     for (const auto &d_ep : ddr_ep)
     {
         const auto &start = d_ep.first;
         const auto &s_net_id = d_ep.second;
         const auto &layer = d_ep.first.z();
-        layers.insert(layer);
+        if (layers.insert(layer).second)
+        {
+            route_candidates.emplace(layer, RerouteQueue(num_nets, m_reroute_priority));
+        }
         for (const auto &c_ep : cpu_ep)
         {
             const auto &end = c_ep.first;
@@ -1220,149 +1375,255 @@ bool DataManager::CPU2DDR_A_Star(const std::vector<std::pair<Coordinate, int>> &
                 continue;
             }
             route_information[s_net_id] = RouteCandidate{start, end, s_net_id, layer};
-            route_candidates[layer].emplace_back(RouteCandidate{start, end, s_net_id, layer});
+            route_candidates.at(layer).push(RouteCandidate{start, end, s_net_id, layer});
             break;
         }
     }
-    for (const auto &layer : layers)
+    // the layers share nothing but the route counter, route them concurrently and merge their paths in layer order
+    std::map<int, std::unordered_map<int, A_Star::PathInfo>> paths; // layer -> (net_id, path)
+    std::map<int, std::future<bool>> results;
     {
-        auto grid = m_grids[layer];
-        while (!route_candidates[layer].empty())
+        ThreadPool pool(std::min<size_t>(m_routing_threads > 0 ? m_routing_threads : std::thread::hardware_concurrency(),
+                                         layers.size()));
+        for (const auto &layer : layers)
         {
-            num_routes++;
-#ifdef VERBOSE
-#endif
-            if (num_routes % 75 == 0)
-                std::cout << "num of routes: " << num_routes << std::endl;
-            if (num_routes > max_routing_attempts)
+            auto &layer_candidates = route_candidates.at(layer);
+            auto &layer_paths = paths[layer];
+            results[layer] = pool.submit(
+                [&, layer]
+                {
+                    return routeLayer(layer,
+                                      layer_candidates,
+                                      route_information,
+                                      layer_paths,
+                                      parent_direction,
+                                      num_routes,
+                                      max_routing_attempts);
+                });
+        }
+    }
+    bool is_success = true;
+    for (auto &result : results)
+    {
+        is_success = result.second.get() && is_success;
+    }
+    if (!is_success)
+    {
+        return false;
+    }
+    for (auto &layer_paths : paths)
+    {
+        for (auto &p_path : layer_paths.second)
+        {
+            auto &PathInfo = p_path.second;
+            auto grid = m_grids[PathInfo.layer];
+            addPointsPath2Segments(
+                *grid, PathInfo.path, PathInfo.net_id, PathInfo.layer, PathInfo.start, PathInfo.end);
+        }
+    }
+    utils::printlog("# of A* routes: " + std::to_string(num_routes));
+    return true;
+}
+
+bool DataManager::routeLayer(const int layer,
+                             RerouteQueue &route_candidates,
+                             const std::unordered_map<int, RouteCandidate> &route_information,
+                             std::unordered_map<int, A_Star::PathInfo> &paths,
+                             const A_Star::Point &parent_direction,
+                             std::atomic<int> &num_routes,
+                             const int &max_routing_attempts)
+{
+    // rip-up and reroute of one layer, only touches its own grid, candidates and paths
+    const int max_grid_growth = 3;
+    auto grid = m_grids.at(layer);
+    int layer_routes = 0;
+    std::unordered_map<int, int> num_conflicts; // net_id -> times it was ripped up by another net
+    // coarse-to-fine mode: the GR cells over the grid and the cells every routed path passes
+    std::optional<A_Star::CoarseGrid> coarse;
+    std::unordered_map<int, std::vector<A_Star::Point>> coarse_paths; // net_id -> GR cells
+    auto makeCoarse = [&]
+    {
+        if (m_coarse_routing && m_GR_cell_width > 0 && m_GR_cell_height > 0)
+        {
+            coarse.emplace(*grid, m_GR_Left_Bottom, m_GR_cell_width, m_GR_cell_height);
+            for (const auto &cells : coarse_paths)
             {
-                return false;
+                coarse->addUsage(cells.second, 1);
             }
+        }
+    };
+    makeCoarse();
+    while (!route_candidates.empty())
+    {
+        const int num_layer_routes = ++layer_routes;
+        const int num_total_routes = ++num_routes;
+#ifdef VERBOSE
+#endif
+        if (num_total_routes % 75 == 0)
+            std::cout << "num of routes: " << num_total_routes << std::endl;
+        if ((m_per_layer_routing_attempts ? num_layer_routes : num_total_routes) > max_routing_attempts)
+        {
+            return false;
+        }
 #ifdef VERBOSE
-            // std::cout << "Routing net_id: " << route_candidates[layer].front().net_id
-            //           << " Layer: " << route_candidates[layer].front().layer
-            //           << " # of waiting: " << route_candidates[layer].size() << std::endl;
+        // std::cout << " # of waiting: " << route_candidates.size() << std::endl;
 #endif
-            auto rc = route_candidates[layer].front();
-            route_candidates[layer].pop_front();
-            auto start = rc.start;
-            auto end = rc.end;
-            auto net_id = rc.net_id;
+        auto rc = route_candidates.pop();
+        auto start = rc.start;
+        auto end = rc.end;
+        auto net_id = rc.net_id;
 
-            // have been routed, need rip-up the old path
-            if (paths.count(net_id))
+        // have been routed, need rip-up the old path
+        if (paths.count(net_id))
+        {
+            grid->ripUpPath(paths[net_id].points());
+        }
+        std::vector<A_Star::Point> old_cells;
+        if (coarse && coarse_paths.count(net_id))
+        {
+            old_cells = std::move(coarse_paths[net_id]);
+            coarse_paths.erase(net_id);
+            coarse->addUsage(old_cells, -1);
+        }
+
+        std::optional<A_Star::Window> corridor;
+        if (m_net_corridor_margin > 0)
+        {
+            A_Star::Point s = grid->toPoint(start), e = grid->toPoint(end);
+            corridor = A_Star::Window{std::min(s.x, e.x) - m_net_corridor_margin,
+                                      std::min(s.y, e.y) - m_net_corridor_margin,
+                                      std::max(s.x, e.x) + m_net_corridor_margin,
+                                      std::max(s.y, e.y) + m_net_corridor_margin};
+        }
+        // the fine search stays near the cheapest coarse path, the room around it grows every time the net was
+        // ripped up, so a congested net gets back to the whole window
+        std::optional<A_Star::Region> region;
+        if (coarse)
+        {
+            auto coarse_path = coarse->route(grid->toPoint(start), grid->toPoint(end));
+            if (!coarse_path.empty())
             {
-                grid->ripUpPath(paths[net_id].points_path);
+                region = coarse->region(coarse_path, m_coarse_margin + num_conflicts[net_id]);
             }
-
-            auto point_path = grid->a_star_search(start, end, parent_direction);
-            if (point_path.size() == 0)
+        }
+        auto point_path =
+            grid->incremental_search(net_id, start, end, parent_direction, corridor, region ? &*region : nullptr);
+        if (point_path.empty() && (corridor || region) && grid->hit_window_edge)
+        {
+            point_path = grid->incremental_search(net_id, start, end, parent_direction, std::nullopt);
+        }
+        // the routing window was in the way, grow it and shift the stored paths of this layer
+        for (int growth = 0; point_path.empty() && grid->hit_window_edge && growth < max_grid_growth; ++growth)
+        {
+            A_Star::Point offset = growGrid(layer, m_grid_margin << growth);
+            grid = m_grids.at(layer);
+            makeCoarse();
+            // the new grid starts without owners, register the shifted paths again
+            for (auto &p : paths)
+            {
+                p.second.path.start = p.second.path.start + offset;
+                grid->addPathOwner(p.second.points(), p.first);
+            }
+            point_path = grid->incremental_search(net_id, start, end, parent_direction, std::nullopt);
+        }
+        if (point_path.size() == 0)
+        {
+            // like its owners, the failed net keeps the usage of its old path
+            if (!old_cells.empty())
             {
+                coarse->addUsage(old_cells, 1);
+                coarse_paths[net_id] = old_cells;
+            }
+            continue;
+        }
+        // overlap or crossing with other paths, add them to rip-up list and add history cost
+        // the conflicting nets come from one walk of point_path over the grid's owner maps, they are still visited in
+        // paths order because the rip-up order steers how the negotiation converges
+        std::unordered_map<int, A_Star::Conflict> conflicts;
+        for (auto &conflict : grid->conflicts(point_path, net_id))
+        {
+            conflicts.emplace(conflict.net_id, std::move(conflict));
+        }
+        for (const auto &p : paths)
+        {
+            auto conflict = conflicts.find(p.first);
+            if (conflict == conflicts.end())
                 continue;
+            // If not queued, add it to the queue, a queued net only gets its priority raised
+            double score = ++num_conflicts[p.first];
+            if (route_candidates.priority() == ReroutePriority::HISTORY_COST)
+            {
+                score = 0;
+                p.second.path.forEachPoint([&](const A_Star::Point &point) { score += grid->cost(point); });
             }
-            // overlap with other path, add to rip-up list and add history cost
-            for (const auto &p : paths)
+            if (!route_candidates.push(route_information.at(p.first), score))
             {
-                const auto &p_info = p.second;
-                if (p_info.layer != layer)
-                    continue;
-                if (p_info.net_id == net_id)
-                    continue;
-                if (grid->isOverlap(p_info.points_path, point_path))
-                {
-                    // If not in deque, add it to deque
-                    bool exist = false;
-                    for (const auto &dq : route_candidates[layer])
-                    {
-                        if (dq.net_id == p_info.net_id)
-                        {
-                            exist = true;
-                            break;
-                        }
-                    }
-                    if (exist)
-                    {
-                        continue;
-                    }
-#ifdef VERBOSE
-                    // std::cout << net_id << " is Overlapped with net_id: " << p_info.net_id << std::endl;
-
-#endif
-                    route_candidates[layer].emplace_back(route_information[p_info.net_id]);
-                    grid->addHistoryCost(grid->overlapPath(p_info.points_path, point_path));
-                }
-                if (grid->isCrossing(p_info.points_path, point_path))
-                {
-                    // If not in deque, add it to deque
-                    bool exist = false;
-                    for (const auto &dq : route_candidates[layer])
-                    {
-                        if (dq.net_id == p_info.net_id)
-                        {
-                            exist = true;
-                            break;
-                        }
-                    }
-                    if (exist)
-                    {
-                        continue;
-                    }
+                continue;
+            }
 #ifdef VERBOSE
-                    // std::cout << net_id << " is Crossing with net_id: " << p_info.net_id << std::endl;
+            // std::cout << net_id << " is Overlapped/Crossing with net_id: " << p.first << std::endl;
 
 #endif
-                    route_candidates[layer].emplace_back(route_information[p_info.net_id]);
-                    // grid->addHistoryCost(grid->crossingPath(p_info.points_path, point_path));
-                    grid->addHistoryCost(p_info.points_path);
-                }
+            if (!conflict->second.overlap.empty())
+            {
+                grid->addHistoryCost(conflict->second.overlap);
             }
-            grid->addPathCost(point_path);
-            paths[net_id] = A_Star::PathInfo{start, end, net_id, layer, point_path};
+            else
+            {
+                // grid->addHistoryCost(grid->crossingPath(p.second.points_path, point_path));
+                grid->addHistoryCost(p.second.points());
+            }
+        }
+        grid->addPathCost(point_path);
+        // the owners follow paths, a failed reroute keeps the old path registered
+        if (paths.count(net_id))
+        {
+            grid->removePathOwner(paths[net_id].points(), net_id);
+        }
+        grid->addPathOwner(point_path, net_id);
+        paths[net_id] = A_Star::PathInfo{start, end, net_id, layer, point_path};
+        if (coarse)
+        {
+            // the usage follows the cells the fine path really passes
+            coarse_paths[net_id] = coarse->cellsOf(point_path);
+            coarse->addUsage(coarse_paths[net_id], 1);
+        }
 #ifdef VERBOSE
-            // debug 可以畫出每round的路徑
-            // if (num_routes % 75 == 0) {
-            //     // copy the m_area_router
-            //     std::shared_ptr<Router> saved_area_router = std::make_shared<Router>();
-            //     for (const auto & s : m_area_router->segments()) {
-            //         saved_area_router->addSegment(s);
-            //     }
-            //     for (const auto & v : m_area_router->vias()) {
-            //         saved_area_router->addVia(v);
-            //     }
-
-            //     for (auto &p_path : paths)
-            //     {
-            //         auto &PathInfo = p_path.second;
-            //         auto grid = m_grids[PathInfo.layer];
-            //         addPointsPath2Segments(
-            //             *grid, PathInfo.points_path, PathInfo.net_id, PathInfo.layer, PathInfo.start, PathInfo.end);
-            //     }
-            //     GDTWriter gdt_writer(*this);
-            //     gdt_writer.debugging(num_routes);
-            //     gdt_writer.gdt2gds("");
-            //     gdt_writer.cleanFiles();
-            //     std::cout << "num_routes: " << num_routes << std::endl;
-            //     // restore the m_area_router
-            //     m_area_router->segments().clear();
-            //     m_area_router->vias().clear();
-            //     for (const auto & s : saved_area_router->segments()) {
-            //         m_area_router->addSegment(s);
-            //     }
-            //     for (const auto & v : saved_area_router->vias()) {
-            //         m_area_router->addVia(v);
-            //     }
-            // }
+        // debug 可以畫出每round的路徑
+        // if (num_routes % 75 == 0) {
+        //     // copy the m_area_router
+        //     std::shared_ptr<Router> saved_area_router = std::make_shared<Router>();
+        //     for (const auto & s : m_area_router->segments()) {
+        //         saved_area_router->addSegment(s);
+        //     }
+        //     for (const auto & v : m_area_router->vias()) {
+        //         saved_area_router->addVia(v);
+        //     }
+
+        //     for (auto &p_path : paths)
+        //     {
+        //         auto &PathInfo = p_path.second;
+        //         auto grid = m_grids[PathInfo.layer];
+        //         addPointsPath2Segments(
+        //             *grid, PathInfo.points_path, PathInfo.net_id, PathInfo.layer, PathInfo.start, PathInfo.end);
+        //     }
+        //     GDTWriter gdt_writer(*this);
+        //     gdt_writer.debugging(num_routes);
+        //     gdt_writer.gdt2gds("");
+        //     gdt_writer.cleanFiles();
+        //     std::cout << "num_routes: " << num_routes << std::endl;
+        //     // restore the m_area_router
+        //     m_area_router->segments().clear();
+        //     m_area_router->vias().clear();
+        //     for (const auto & s : saved_area_router->segments()) {
+        //         m_area_router->addSegment(s);
+        //     }
+        //     for (const auto & v : saved_area_router->vias()) {
+        //         m_area_router->addVia(v);
+        //     }
+        // }
 #endif
-        }
-    }
-    for (auto &p_path : paths)
-    {
-        auto &PathInfo = p_path.second;
-        auto grid = m_grids[PathInfo.layer];
-        addPointsPath2Segments(
-            *grid, PathInfo.points_path, PathInfo.net_id, PathInfo.layer, PathInfo.start, PathInfo.end);
     }
-    utils::printlog("# of A* routes: " + std::to_string(num_routes));
     return true;
 }
 
@@ -1520,14 +1781,24 @@ void DataManager::turnCPUEscapePoint(const double &spacing,
     }
 }
 
-void DataManager::markExistingObstacles()
+void DataManager::markExistingObstacles(const std::optional<int> &only_layer)
 {
+    // grid of the layer if it should be marked
+    auto gridOf = [&](const int layer) -> A_Star::Grid *
+    {
+        if (only_layer && *only_layer != layer)
+        {
+            return nullptr;
+        }
+        auto it = m_grids.find(layer);
+        return it == m_grids.end() ? nullptr : it->second.get();
+    };
     // Obstacles
     for (const auto o : m_obstacles)
     {
-        if (m_grids.count(o.layer()))
+        if (auto grid = gridOf(o.layer()))
         {
-            m_grids[o.layer()]->addObstacle(o);
+            grid->addObstacle(o);
         }
     }
     // Segments
@@ -1536,17 +1807,17 @@ void DataManager::markExistingObstacles()
         auto &comp = comp_pair.second;
         for (auto &seg : comp->router()->segments())
         {
-            if (m_grids.count(seg.layer()))
+            if (auto grid = gridOf(seg.layer()))
             {
-                m_grids[seg.layer()]->addObstacle(seg);
+                grid->addObstacle(seg);
             }
         }
     }
     for (auto &seg : m_area_router->segments())
     {
-        if (m_grids.count(seg.layer()))
+        if (auto grid = gridOf(seg.layer()))
         {
-            m_grids[seg.layer()]->addObstacle(seg);
+            grid->addObstacle(seg);
         }
     }
     // Vias
@@ -1557,9 +1828,9 @@ void DataManager::markExistingObstacles()
         {
             for (int l = 0; l <= via.layer(); l++)
             {
-                if (m_grids.count(l))
+                if (auto grid = gridOf(l))
                 {
-                    m_grids[l]->addObstacle(via);
+                    grid->addObstacle(via);
                 }
             }
         }
@@ -1568,9 +1839,9 @@ void DataManager::markExistingObstacles()
     {
         for (int l = 0; l <= via.layer(); l++)
         {
-            if (m_grids.count(l))
+            if (auto grid = gridOf(l))
             {
-                m_grids[l]->addObstacle(via);
+                grid->addObstacle(via);
             }
         }
     }
@@ -1579,9 +1850,9 @@ void DataManager::markExistingObstacles()
     {
         for (const auto &s : ds)
         {
-            if (m_grids.count(s.layer()))
+            if (auto grid = gridOf(s.layer()))
             {
-                m_grids[s.layer()]->addObstacle(s);
+                grid->addObstacle(s);
             }
         }
     }
@@ -1755,13 +2026,17 @@ void DataManager::CPU2DDRAreaRouting()
                 }
                 // find out the segment between comp2 and comp3 in m_area_router
                 std::vector<Segment> area_segments;
+                std::vector<SegmentHandle> area_handles; // to remove area_segments from m_area_router
                 if (ddr2ddr_edge.first.second == 'E' && ddr2ddr_edge.second.second == 'W')
                 {
-                    for (auto &s : m_area_router->segments())
+                    auto &router_segments = m_area_router->segments();
+                    for (size_t i = 0; i < router_segments.size(); ++i)
                     {
+                        const auto &s = router_segments[i];
                         if (s.start().y() <= area_wire_top_y && s.end().y() >= area_wire_bottom_y)
                         {
                             area_segments.push_back(s);
+                            area_handles.push_back(m_area_router->handle(i));
                         }
                     }
                 }
@@ -1806,12 +2081,13 @@ void DataManager::CPU2DDRAreaRouting()
                     // find segments include current_y and net_id
                     for (auto &cgep : cpu_group_escape_points)
                     {
-                        for (auto &s : area_segments)
+                        for (size_t k = 0; k < area_segments.size(); ++k)
                         {
+                            auto &s = area_segments[k];
                             if (s.isInclude(std::numeric_limits<double>::quiet_NaN(), current_y) &&
                                 s.net_id() == cgep.second)
                             {
-                                m_area_router->removeSegment(s);
+                                m_area_router->removeSegment(area_handles[k]);
                                 current_x = s.findCoordinate(std::numeric_limits<double>::quiet_NaN(), current_y);
                                 if (s.start().y() < s.end().y())
                                 {
@@ -1827,11 +2103,7 @@ void DataManager::CPU2DDRAreaRouting()
                                 Segment second_bend = tmp_s.createExtendedSegmentByDegree(
                                     -135, current_x - peak_height, std::numeric_limits<double>::quiet_NaN());
                                 Segment connect(first_bend.end(), second_bend.end(), s.net_id());
-                                m_area_router->addSegment(s);
-                                m_area_router->addSegment(first_bend);
-                                m_area_router->addSegment(second_bend);
-                                m_area_router->addSegment(tmp_s);
-                                m_area_router->addSegment(connect);
+                                m_area_router->addSegments({s, first_bend, second_bend, tmp_s, connect});
                                 m_area_router->addVia(
                                     Via(Coordinate(current_x - peak_height, current_y, s.end().z()), 0, s.net_id()));
                                 break;
@@ -1902,13 +2174,17 @@ void DataManager::CPU2DDRAreaRouting()
                 }
                 // find out the segment between comp2 and comp3 in m_area_router
                 std::vector<Segment> area_segments;
+                std::vector<SegmentHandle> area_handles; // to remove area_segments from m_area_router
                 if (ddr2ddr_edge.first.second == 'E' && ddr2ddr_edge.second.second == 'W')
                 {
-                    for (auto &s : m_area_router->segments())
+                    auto &router_segments = m_area_router->segments();
+                    for (size_t i = 0; i < router_segments.size(); ++i)
                     {
+                        const auto &s = router_segments[i];
                         if (s.start().y() <= area_wire_top_y && s.end().y() >= area_wire_bottom_y)
                         {
                             area_segments.push_back(s);
+                            area_handles.push_back(m_area_router->handle(i));
                         }
                     }
                 }
@@ -1967,12 +2243,13 @@ void DataManager::CPU2DDRAreaRouting()
                     // find segments include current_y and net_id
                     for (auto &cgep : cpu_group_escape_points)
                     {
-                        for (auto &s : area_segments)
+                        for (size_t k = 0; k < area_segments.size(); ++k)
                         {
+                            auto &s = area_segments[k];
                             if (s.isInclude(std::numeric_limits<double>::quiet_NaN(), current_y) &&
                                 s.net_id() == cgep.second)
                             {
-                                m_area_router->removeSegment(s);
+                                m_area_router->removeSegment(area_handles[k]);
                                 current_x = s.findCoordinate(std::numeric_limits<double>::quiet_NaN(), current_y);
                                 if (s.start().y() < s.end().y())
                                 {
@@ -1999,11 +2276,7 @@ void DataManager::CPU2DDRAreaRouting()
                                 Segment second_bend =
                                     tmp_s.createExtendedSegmentByDegreeAndLength(tmp_degree, peak_height * sqrt(2));
                                 Segment connect(first_bend.end(), second_bend.end(), s.net_id());
-                                m_area_router->addSegment(s);
-                                m_area_router->addSegment(first_bend);
-                                m_area_router->addSegment(second_bend);
-                                m_area_router->addSegment(tmp_s);
-                                m_area_router->addSegment(connect);
+                                m_area_router->addSegments({s, first_bend, second_bend, tmp_s, connect});
                                 if (deq(s.slope(), 1, 1e3))
                                 {
                                     // 拉到 CPU 左邊 2.5 CPU寬度
@@ -2204,445 +2477,814 @@ std::shared_ptr<Component> DataManager::getCPUComponent()
     return nullptr;
 }
 
+uint64_t Router::endpointKey(long long x, long long y, int z)
+{
+    // colliding keys only cost a few extra candidates, touching is checked on the coordinates
+    return (static_cast<uint64_t>(x) * 0x9E3779B97F4A7C15ULL) ^ (static_cast<uint64_t>(y) << 20) ^
+           static_cast<uint64_t>(z);
+}
+
+void Router::fileSegment(size_t i)
+{
+    const auto &seg = m_segments[i];
+    m_endpoint_keys[i] = {endpointKey(std::floor(seg.start().x()), std::floor(seg.start().y()), seg.start().z()),
+                          endpointKey(std::floor(seg.end().x()), std::floor(seg.end().y()), seg.end().z())};
+    m_endpoint_index[m_endpoint_keys[i].first].push_back(i);
+    if (m_endpoint_keys[i].second != m_endpoint_keys[i].first)
+    {
+        m_endpoint_index[m_endpoint_keys[i].second].push_back(i);
+    }
+}
+
+void Router::unfileSegment(size_t i)
+{
+    for (uint64_t key : {m_endpoint_keys[i].first, m_endpoint_keys[i].second})
+    {
+        auto bucket = m_endpoint_index.find(key);
+        if (bucket == m_endpoint_index.end())
+        {
+            continue;
+        }
+        auto &ids = bucket->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), i), ids.end());
+        if (ids.empty())
+        {
+            m_endpoint_index.erase(bucket);
+        }
+    }
+}
+
+void Router::indexSegments()
+{
+    m_endpoint_index.clear();
+    m_endpoint_keys.assign(m_segments.size(), {});
+    for (size_t i = 0; i < m_segments.size(); ++i)
+    {
+        fileSegment(i);
+    }
+    m_indexed = true;
+}
+
+// Segments with an endpoint close to an endpoint of segment i, in position order
+std::vector<size_t> Router::touchingSegments(size_t i) const
+{
+    const auto &seg = m_segments[i];
+    std::vector<size_t> touching;
+    for (const auto &end : {seg.start(), seg.end()})
+    {
+        // isCloseTo tolerance is below the bucket size, the neighbouring buckets are enough
+        long long x = std::floor(end.x()), y = std::floor(end.y());
+        for (long long dx = -1; dx <= 1; ++dx)
+        {
+            for (long long dy = -1; dy <= 1; ++dy)
+            {
+                auto bucket = m_endpoint_index.find(endpointKey(x + dx, y + dy, end.z()));
+                if (bucket == m_endpoint_index.end())
+                {
+                    continue;
+                }
+                for (size_t j : bucket->second)
+                {
+                    const auto &other = m_segments[j];
+                    if (j != i && (end.isCloseTo(other.start()) || end.isCloseTo(other.end())))
+                    {
+                        touching.push_back(j);
+                    }
+                }
+            }
+        }
+    }
+    std::sort(touching.begin(), touching.end());
+    touching.erase(std::unique(touching.begin(), touching.end()), touching.end());
+    return touching;
+}
+
 void Router::addSegment(Segment segment)
 {
-    m_segments.push_back(segment); // add new segment
+    addSegments({segment});
+}
+
+void Router::addSegments(const std::vector<Segment> &segments)
+{
+    // Every pass visits the segments in order and joins each of them with the touching segments in order: collinear
+    // ones merge into it, perpendicular ones get a 45 degree corner. Only pairs with a segment that changed since the
+    // pair was last checked can do anything, so a pass only visits the segments in m_unjoined and the ones touching
+    // them, found through the endpoint index.
+    if (!m_indexed)
+    {
+        // the segments may have been changed from outside, check every pair once more
+        syncSlots();
+        indexSegments();
+        for (size_t i = 0; i < m_segments.size(); ++i)
+        {
+            m_unjoined.insert(i);
+        }
+    }
+    auto isRemoved = [](const Segment &seg) { return seg.start() == Coordinate(-1, -1, -1); };
+    auto touches = [](const Segment &s, const Segment &other_s)
+    {
+        return s.start().isCloseTo(other_s.start()) || s.end().isCloseTo(other_s.start()) ||
+               s.start().isCloseTo(other_s.end()) || s.end().isCloseTo(other_s.end());
+    };
+    // add new segments, they are joined together in the passes below
+    for (const auto &segment : segments)
+    {
+        appendSegment(segment);
+    }
+    for (size_t i = m_segments.size() - segments.size(); i < m_segments.size(); ++i)
+    {
+        m_unjoined.insert(i);
+        for (size_t j : touchingSegments(i))
+        {
+            m_unjoined.insert(j);
+        }
+    }
     bool merged = true;
     while (merged)
     {
         merged = false;
-        for (auto &s : m_segments)
+        // segments added in this pass are visited in the next one
+        const size_t end = m_segments.size();
+        std::set<size_t> pending;
+        for (auto it = m_unjoined.begin(); it != m_unjoined.end() && *it < end;)
+        {
+            pending.insert(*it);
+            it = m_unjoined.erase(it);
+        }
+        while (!pending.empty())
         {
-            for (auto &other_s : m_segments)
+            const size_t i = *pending.begin();
+            pending.erase(pending.begin());
+            if (isRemoved(m_segments[i]))
             {
-                if (s == other_s)
-                    continue;
-                double diagonal_factor = 0.25;
-                double diagonal_short_segments = 30.0;
-                if (s.start().isCloseTo(other_s.start()))
+                continue;
+            }
+            // a changed segment is checked again with everything it touches, later in this pass if it comes after i,
+            // otherwise in the next pass or the next addSegment
+            auto changed = [&](size_t k)
+            {
+                unfileSegment(k);
+                if (isRemoved(m_segments[k]))
+                {
+                    return;
+                }
+                fileSegment(k);
+                std::vector<size_t> touching = touchingSegments(k);
+                touching.push_back(k);
+                for (size_t j : touching)
                 {
-                    if (fabs(s.slope() - other_s.slope()) > 5e-1)
+                    if (j > i && j < end)
                     {
-                        other_s.net_id() = std::max(other_s.net_id(), s.net_id());
-
-                        // 如果兩條線垂直(slope相乘等於-1), 連接的部分必須變成45度, s.start() 和 other_s.start() 連接
-                        if (s.slope() == std::numeric_limits<double>::infinity() && deq(other_s.slope(), 0))
-                        {
-                            if (s.start().y() > s.end().y())
-                            {
-                                s.start().y() = s.start().y() - diagonal_factor * diagonal_short_segments;
-                                if (other_s.start().x() > other_s.end().x())
-                                {
-                                    other_s.start().x() =
-                                        other_s.start().x() - diagonal_factor * diagonal_short_segments;
-                                }
-                                else
-                                {
-                                    other_s.start().x() =
-                                        other_s.start().x() + diagonal_factor * diagonal_short_segments;
-                                }
-                                Segment diagonal(s.start(), other_s.start(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                            else
-                            {
-                                s.start().y() = s.start().y() + diagonal_factor * diagonal_short_segments;
-                                if (other_s.start().x() > other_s.end().x())
-                                {
-                                    other_s.start().x() =
-                                        other_s.start().x() - diagonal_factor * diagonal_short_segments;
-                                }
-                                else
-                                {
-                                    other_s.start().x() =
-                                        other_s.start().x() + diagonal_factor * diagonal_short_segments;
-                                }
-                                Segment diagonal(s.start(), other_s.start(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                        }
-                        else if (other_s.slope() == std::numeric_limits<double>::infinity() && deq(s.slope(), 0))
-                        {
-                            if (other_s.start().y() > other_s.end().y())
-                            {
-                                other_s.start().y() =
-                                    other_s.start().y() -
-                                    diagonal_factor * (std::fabs(other_s.start().y() - other_s.end().y()));
-                                if (s.start().x() > s.end().x())
-                                {
-                                    s.start().x() =
-                                        s.start().x() - diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
-                                }
-                                else
-                                {
-                                    s.start().x() =
-                                        s.start().x() + diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
-                                }
-                                Segment diagonal(s.start(), other_s.start(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                            else
-                            {
-                                other_s.start().y() =
-                                    other_s.start().y() +
-                                    diagonal_factor * (std::fabs(other_s.start().y() - other_s.end().y()));
-                                if (s.start().x() > s.end().x())
-                                {
-                                    s.start().x() =
-                                        s.start().x() - diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
-                                }
-                                else
-                                {
-                                    s.start().x() =
-                                        s.start().x() + diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
-                                }
-                                Segment diagonal(s.start(), other_s.start(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                        }
-                        continue;
+                        pending.insert(j);
                     }
-                    s.start() = other_s.end(); // update start point
-                    s.net_id() = std::max(s.net_id(), other_s.net_id());
-                    other_s.start() = Coordinate(-1, -1, -1);
-                    other_s.end() = Coordinate(-1, -1, -1);
-                    merged = true;
-                    break;
-                }
-                else if (s.end().isCloseTo(other_s.start()))
-                {
-                    if (fabs(s.slope() - other_s.slope()) > 5e-1)
+                    else
                     {
-                        other_s.net_id() = std::max(other_s.net_id(), s.net_id());
-
-                        // 如果兩條線垂直(slope相乘等於-1), 連接的部分必須變成45度, s.end() 和 other_s.start() 連接
-                        if (s.slope() == std::numeric_limits<double>::infinity() && deq(other_s.slope(), 0))
-                        {
-                            if (s.end().y() > s.start().y())
-                            {
-                                s.end().y() = s.end().y() - diagonal_factor * (std::fabs(s.end().y() - s.start().y()));
-                                if (other_s.start().x() > other_s.end().x())
-                                {
-                                    other_s.start().x() =
-                                        other_s.start().x() - diagonal_factor * diagonal_short_segments;
-                                }
-                                else
-                                {
-                                    other_s.start().x() =
-                                        other_s.start().x() + diagonal_factor * diagonal_short_segments;
-                                }
-                                Segment diagonal(s.end(), other_s.start(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                            else
-                            {
-                                s.end().y() = s.end().y() + diagonal_factor * (std::fabs(s.end().y() - s.start().y()));
-                                if (other_s.start().x() > other_s.end().x())
-                                {
-                                    other_s.start().x() =
-                                        other_s.start().x() - diagonal_factor * diagonal_short_segments;
-                                }
-                                else
-                                {
-                                    other_s.start().x() =
-                                        other_s.start().x() + diagonal_factor * diagonal_short_segments;
-                                }
-                                Segment diagonal(s.end(), other_s.start(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                        }
-                        else if (other_s.slope() == std::numeric_limits<double>::infinity() && deq(s.slope(), 0))
-                        {
-                            if (other_s.start().y() > other_s.end().y())
-                            {
-                                other_s.start().y() =
-                                    other_s.start().y() -
-                                    diagonal_factor * (std::fabs(other_s.start().y() - other_s.end().y()));
-                                if (s.end().x() > s.start().x())
-                                {
-                                    s.end().x() =
-                                        s.end().x() - diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
-                                }
-                                else
-                                {
-                                    s.end().x() =
-                                        s.end().x() + diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
-                                }
-                                Segment diagonal(s.end(), other_s.start(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                            else
-                            {
-                                other_s.start().y() =
-                                    other_s.start().y() +
-                                    diagonal_factor * (std::fabs(other_s.start().y() - other_s.end().y()));
-                                if (s.end().x() > s.start().x())
-                                {
-                                    s.end().x() =
-                                        s.end().x() - diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
-                                }
-                                else
-                                {
-                                    s.end().x() =
-                                        s.end().x() + diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
-                                }
-                                Segment diagonal(s.end(), other_s.start(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                        }
-
-                        continue;
+                        m_unjoined.insert(j);
                     }
-                    s.end() = other_s.end(); // extend end point
-                    merged = true;
-                    s.net_id() = std::max(s.net_id(), other_s.net_id());
-                    other_s.start() = Coordinate(-1, -1, -1);
-                    other_s.end() = Coordinate(-1, -1, -1);
-                    break;
                 }
-                else if (s.start().isCloseTo(other_s.end()))
+            };
+            // segments added while joining i are not checked against it before the next pass
+            const size_t others = m_segments.size();
+            size_t next = 0;
+            while (true)
+            {
+                size_t o = others;
+                if (!merged)
                 {
-                    if (fabs(s.slope() - other_s.slope()) > 5e-1)
+                    // next touching segment, s may have changed since the last one
+                    for (size_t j : touchingSegments(i))
                     {
-                        other_s.net_id() = std::max(other_s.net_id(), s.net_id());
-                        // 如果兩條線垂直(slope相乘等於-1), 連接的部分必須變成45度, s.start() 和 other_s.end() 連接
-                        if (s.slope() == std::numeric_limits<double>::infinity() && deq(other_s.slope(), 0))
+                        if (j >= next && j < others)
                         {
-                            if (s.start().y() > s.end().y())
-                            {
-                                s.start().y() = s.start().y() - diagonal_factor * diagonal_short_segments;
-                                if (other_s.end().x() > other_s.start().x())
-                                {
-                                    other_s.end().x() =
-                                        other_s.end().x() -
-                                        diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
-                                }
-                                else
-                                {
-                                    other_s.end().x() =
-                                        other_s.end().x() +
-                                        diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
-                                }
-                                Segment diagonal(s.start(), other_s.end(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                            else
-                            {
-                                s.start().y() = s.start().y() + diagonal_factor * diagonal_short_segments;
-                                if (other_s.end().x() > other_s.start().x())
-                                {
-                                    other_s.end().x() =
-                                        other_s.end().x() -
-                                        diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
-                                }
-                                else
-                                {
-                                    other_s.end().x() =
-                                        other_s.end().x() +
-                                        diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
-                                }
-                                Segment diagonal(s.start(), other_s.end(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                        }
-                        else if (other_s.slope() == std::numeric_limits<double>::infinity() && deq(s.slope(), 0))
-                        {
-                            if (other_s.end().y() > other_s.start().y())
-                            {
-                                other_s.end().y() =
-                                    other_s.end().y() -
-                                    diagonal_factor * (std::fabs(other_s.end().y() - other_s.start().y()));
-                                if (s.start().x() > s.end().x())
-                                {
-                                    s.start().x() =
-                                        s.start().x() - diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
-                                }
-                                else
-                                {
-                                    s.start().x() =
-                                        s.start().x() + diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
-                                }
-                                Segment diagonal(s.start(), other_s.end(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                            else
-                            {
-                                other_s.end().y() =
-                                    other_s.end().y() +
-                                    diagonal_factor * (std::fabs(other_s.end().y() - other_s.start().y()));
-                                if (s.start().x() > s.end().x())
-                                {
-                                    s.start().x() =
-                                        s.start().x() - diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
-                                }
-                                else
-                                {
-                                    s.start().x() =
-                                        s.start().x() + diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
-                                }
-                                Segment diagonal(s.start(), other_s.end(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
+                            o = j;
+                            break;
                         }
-
-                        continue;
                     }
-                    s.start() = other_s.start(); // update start point
-                    merged = true;
-                    s.net_id() = std::max(s.net_id(), other_s.net_id());
-                    other_s.start() = Coordinate(-1, -1, -1);
-                    other_s.end() = Coordinate(-1, -1, -1);
-                    break;
                 }
-                else if (s.end().isCloseTo(other_s.end()))
+                else
                 {
-                    if (fabs(s.slope() - other_s.slope()) > 5e-1)
+                    // once the pass merged, the scan of s stops at the first segment that neither equals nor touches
+                    // it, the rest of its pairs wait for the next pass
+                    while (next < others && m_segments[next] == m_segments[i])
                     {
-                        other_s.net_id() = std::max(other_s.net_id(), s.net_id());
-                        // 如果兩條線垂直(slope相乘等於-1), 連接的部分必須變成45度, s.end() 和 other_s.end() 連接
-                        if (s.slope() == std::numeric_limits<double>::infinity() && deq(other_s.slope(), 0))
-                        {
-                            if (s.end().y() > s.start().y())
-                            {
-                                s.end().y() = s.end().y() - diagonal_factor * (std::fabs(s.end().y() - s.start().y()));
-                                if (other_s.end().x() > other_s.start().x())
-                                {
-                                    other_s.end().x() =
-                                        other_s.end().x() -
-                                        diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
-                                }
-                                else
-                                {
-                                    other_s.end().x() =
-                                        other_s.end().x() +
-                                        diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
-                                }
-                                Segment diagonal(s.end(), other_s.end(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                            else
-                            {
-                                s.end().y() = s.end().y() + diagonal_factor * (std::fabs(s.end().y() - s.start().y()));
-                                if (other_s.end().x() > other_s.start().x())
-                                {
-                                    other_s.end().x() =
-                                        other_s.end().x() -
-                                        diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
-                                }
-                                else
-                                {
-                                    other_s.end().x() =
-                                        other_s.end().x() +
-                                        diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
-                                }
-                                Segment diagonal(s.end(), other_s.end(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                        }
-                        else if (other_s.slope() == std::numeric_limits<double>::infinity() && deq(s.slope(), 0))
-                        {
-                            if (other_s.end().y() > other_s.start().y())
-                            {
-                                other_s.end().y() =
-                                    other_s.end().y() -
-                                    diagonal_factor * (std::fabs(other_s.end().y() - other_s.start().y()));
-                                if (s.end().x() > s.start().x())
-                                {
-                                    s.end().x() =
-                                        s.end().x() - diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
-                                }
-                                else
-                                {
-                                    s.end().x() =
-                                        s.end().x() + diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
-                                }
-                                Segment diagonal(s.end(), other_s.end(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                            else
-                            {
-                                other_s.end().y() =
-                                    other_s.end().y() +
-                                    diagonal_factor * (std::fabs(other_s.end().y() - other_s.start().y()));
-                                if (s.end().x() > s.start().x())
-                                {
-                                    s.end().x() =
-                                        s.end().x() - diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
-                                }
-                                else
-                                {
-                                    s.end().x() =
-                                        s.end().x() + diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
-                                }
-                                Segment diagonal(s.end(), other_s.end(), s.net_id());
-                                m_segments.push_back(diagonal);
-                            }
-                        }
-                        continue;
+                        ++next;
                     }
-                    s.end() = other_s.start(); // extend end point
-                    merged = true;
-                    s.net_id() = std::max(s.net_id(), other_s.net_id());
-                    other_s.start() = Coordinate(-1, -1, -1);
-                    other_s.end() = Coordinate(-1, -1, -1);
+                    if (next < others && touches(m_segments[i], m_segments[next]))
+                    {
+                        o = next;
+                    }
+                    else if (!touchingSegments(i).empty())
+                    {
+                        m_unjoined.insert(i);
+                    }
+                }
+                if (o == others)
+                {
                     break;
                 }
-                if (merged)
+                next = o + 1;
+                if (m_segments[i] == m_segments[o])
+                    continue;
+                const Segment s_before = m_segments[i], other_before = m_segments[o];
+                std::vector<Segment> diagonals;
+                bool joined = joinSegments(m_segments[i], m_segments[o], diagonals);
+                for (const auto &diagonal : diagonals)
+                {
+                    appendSegment(diagonal);
+                    changed(m_segments.size() - 1);
+                }
+                auto differs = [](const Segment &a, const Segment &b)
+                {
+                    return a.start().x() != b.start().x() || a.start().y() != b.start().y() ||
+                           a.end().x() != b.end().x() || a.end().y() != b.end().y() || a.net_id() != b.net_id();
+                };
+                if (differs(m_segments[o], other_before))
+                {
+                    changed(o);
+                }
+                if (differs(m_segments[i], s_before))
+                {
+                    changed(i);
+                }
+                if (joined)
+                {
+                    releaseSlot(o);
+                    merged = m_has_removed = true;
                     break;
+                }
             }
         }
     }
     // remove empty segments
-    m_segments.erase(std::remove_if(m_segments.begin(),
-                                    m_segments.end(),
-                                    [](const Segment &seg) { return seg.start() == Coordinate(-1, -1, -1); }),
-                     m_segments.end());
+    compact();
 }
 
-void Router::setViaNetId()
+void Router::appendSegment(const Segment &segment)
 {
-    // find overlap with which segments then update the net_id
-    for (auto &v : m_vias)
+    m_segments.push_back(segment);
+    m_endpoint_keys.emplace_back();
+    fileSegment(m_segments.size() - 1);
+    uint32_t slot;
+    if (m_free_slots.empty())
     {
-        for (auto &seg : m_segments)
+        slot = m_slots.size();
+        m_slots.emplace_back();
+    }
+    else
+    {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+    }
+    m_slots[slot].position = m_segments.size() - 1;
+    m_slot_of.push_back(slot);
+}
+
+void Router::releaseSlot(size_t i)
+{
+    Slot &slot = m_slots[m_slot_of[i]];
+    if (slot.position != i)
+    {
+        return;
+    }
+    slot.position = std::numeric_limits<size_t>::max();
+    ++slot.generation;
+    m_free_slots.push_back(m_slot_of[i]);
+}
+
+// Segments pushed or erased through segments() get fresh slots, the handles given out before no longer resolve
+void Router::syncSlots()
+{
+    if (m_slot_of.size() == m_segments.size())
+    {
+        return;
+    }
+    for (auto &slot : m_slots)
+    {
+        if (slot.position != std::numeric_limits<size_t>::max())
         {
-            if (seg.isOverlap(v))
-            {
-                v.net_id() = std::max(seg.net_id(), v.net_id());
-                break;
-            }
+            slot.position = std::numeric_limits<size_t>::max();
+            ++slot.generation;
         }
     }
+    m_free_slots.clear();
+    for (uint32_t slot = m_slots.size(); slot-- > 0;)
+    {
+        m_free_slots.push_back(slot);
+    }
+    m_slot_of.clear();
+    for (size_t i = 0; i < m_segments.size(); ++i)
+    {
+        uint32_t slot;
+        if (m_free_slots.empty())
+        {
+            slot = m_slots.size();
+            m_slots.emplace_back();
+        }
+        else
+        {
+            slot = m_free_slots.back();
+            m_free_slots.pop_back();
+        }
+        m_slots[slot].position = i;
+        m_slot_of.push_back(slot);
+    }
+    m_unjoined.clear();
+    m_indexed = false;
 }
 
-void Router::setSegmentNetId()
+// Drop the removed segments from m_segments, keeping the order of the others, it decides which one survives a later
+// merge
+void Router::compact()
 {
-    for (auto &seg : m_segments)
+    if (!m_has_removed)
+    {
+        return;
+    }
+    m_has_removed = false;
+    std::vector<int> position(m_segments.size(), -1);
+    size_t kept = 0;
+    for (size_t i = 0; i < m_segments.size(); ++i)
+    {
+        // a released slot may already be reused by a segment added after i
+        if (m_slots[m_slot_of[i]].position == i)
+        {
+            position[i] = kept;
+            m_segments[kept] = m_segments[i];
+            m_slot_of[kept] = m_slot_of[i];
+            m_slots[m_slot_of[kept]].position = kept;
+            ++kept;
+        }
+    }
+    m_segments.resize(kept);
+    m_slot_of.resize(kept);
+    std::set<size_t> unjoined;
+    for (size_t i : m_unjoined)
+    {
+        if (position[i] >= 0)
+        {
+            unjoined.insert(position[i]);
+        }
+    }
+    m_unjoined.swap(unjoined);
+    if (m_indexed)
     {
+        indexSegments();
+    }
+}
 
-        for (auto &v : m_vias)
+void Router::removeSegment(const SegmentHandle &handle)
+{
+    if (!isValid(handle))
+    {
+        return;
+    }
+    size_t i = m_slots[handle.slot].position;
+    if (m_indexed)
+    {
+        unfileSegment(i);
+    }
+    releaseSlot(i);
+    m_segments[i].start() = Coordinate(-1, -1, -1);
+    m_segments[i].end() = Coordinate(-1, -1, -1);
+    m_has_removed = true;
+}
+
+void Router::removeSegment(Segment segment)
+{
+    // remove the segment from the vector
+    // iterate the segments it and remove it
+    syncSlots();
+    for (size_t i = 0; i < m_segments.size(); ++i)
+    {
+        if (m_segments[i] == segment)
+        {
+            removeSegment(handle(i));
+        }
+    }
+    compact();
+}
+
+// Join the touching segments s and other_s: collinear ones merge into s (other_s is emptied, return true),
+// perpendicular ones get a 45 degree corner added to diagonals
+bool Router::joinSegments(Segment &s, Segment &other_s, std::vector<Segment> &diagonals)
+{
+    double diagonal_factor = 0.25;
+    double diagonal_short_segments = 30.0;
+    if (s.start().isCloseTo(other_s.start()))
+    {
+        if (fabs(s.slope() - other_s.slope()) > 5e-1)
         {
-            if (seg.isOverlap(v))
+            other_s.net_id() = std::max(other_s.net_id(), s.net_id());
+
+            // 如果兩條線垂直(slope相乘等於-1), 連接的部分必須變成45度, s.start() 和 other_s.start() 連接
+            if (s.slope() == std::numeric_limits<double>::infinity() && deq(other_s.slope(), 0))
+            {
+                if (s.start().y() > s.end().y())
+                {
+                    s.start().y() = s.start().y() - diagonal_factor * diagonal_short_segments;
+                    if (other_s.start().x() > other_s.end().x())
+                    {
+                        other_s.start().x() = other_s.start().x() - diagonal_factor * diagonal_short_segments;
+                    }
+                    else
+                    {
+                        other_s.start().x() = other_s.start().x() + diagonal_factor * diagonal_short_segments;
+                    }
+                    Segment diagonal(s.start(), other_s.start(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+                else
+                {
+                    s.start().y() = s.start().y() + diagonal_factor * diagonal_short_segments;
+                    if (other_s.start().x() > other_s.end().x())
+                    {
+                        other_s.start().x() = other_s.start().x() - diagonal_factor * diagonal_short_segments;
+                    }
+                    else
+                    {
+                        other_s.start().x() = other_s.start().x() + diagonal_factor * diagonal_short_segments;
+                    }
+                    Segment diagonal(s.start(), other_s.start(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+            }
+            else if (other_s.slope() == std::numeric_limits<double>::infinity() && deq(s.slope(), 0))
             {
-                if (seg.net_id() != -1 && seg.net_id() != v.net_id())
+                if (other_s.start().y() > other_s.end().y())
                 {
-                    throw std::runtime_error("Error: Segment net_id != Via net_id");
+                    other_s.start().y() = other_s.start().y() -
+                        diagonal_factor * (std::fabs(other_s.start().y() - other_s.end().y()));
+                    if (s.start().x() > s.end().x())
+                    {
+                        s.start().x() = s.start().x() - diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
+                    }
+                    else
+                    {
+                        s.start().x() = s.start().x() + diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
+                    }
+                    Segment diagonal(s.start(), other_s.start(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+                else
+                {
+                    other_s.start().y() = other_s.start().y() +
+                        diagonal_factor * (std::fabs(other_s.start().y() - other_s.end().y()));
+                    if (s.start().x() > s.end().x())
+                    {
+                        s.start().x() = s.start().x() - diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
+                    }
+                    else
+                    {
+                        s.start().x() = s.start().x() + diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
+                    }
+                    Segment diagonal(s.start(), other_s.start(), s.net_id());
+                    diagonals.push_back(diagonal);
                 }
-                seg.net_id() = std::max(seg.net_id(), v.net_id());
             }
+            return false;
         }
+        s.start() = other_s.end(); // update start point
+        s.net_id() = std::max(s.net_id(), other_s.net_id());
+        other_s.start() = Coordinate(-1, -1, -1);
+        other_s.end() = Coordinate(-1, -1, -1);
+        return true;
     }
-    // // set overlapping segments to the same net_id
-    for (auto &seg : m_segments)
+    else if (s.end().isCloseTo(other_s.start()))
     {
-        for (auto &other_seg : m_segments)
+        if (fabs(s.slope() - other_s.slope()) > 5e-1)
         {
-            if (seg == other_seg)
-                continue;
-            if (seg.isOverlap(other_seg.start()) || seg.isOverlap(other_seg.end()))
+            other_s.net_id() = std::max(other_s.net_id(), s.net_id());
+
+            // 如果兩條線垂直(slope相乘等於-1), 連接的部分必須變成45度, s.end() 和 other_s.start() 連接
+            if (s.slope() == std::numeric_limits<double>::infinity() && deq(other_s.slope(), 0))
             {
-                seg.net_id() = std::max(seg.net_id(), other_seg.net_id());
+                if (s.end().y() > s.start().y())
+                {
+                    s.end().y() = s.end().y() - diagonal_factor * (std::fabs(s.end().y() - s.start().y()));
+                    if (other_s.start().x() > other_s.end().x())
+                    {
+                        other_s.start().x() = other_s.start().x() - diagonal_factor * diagonal_short_segments;
+                    }
+                    else
+                    {
+                        other_s.start().x() = other_s.start().x() + diagonal_factor * diagonal_short_segments;
+                    }
+                    Segment diagonal(s.end(), other_s.start(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+                else
+                {
+                    s.end().y() = s.end().y() + diagonal_factor * (std::fabs(s.end().y() - s.start().y()));
+                    if (other_s.start().x() > other_s.end().x())
+                    {
+                        other_s.start().x() = other_s.start().x() - diagonal_factor * diagonal_short_segments;
+                    }
+                    else
+                    {
+                        other_s.start().x() = other_s.start().x() + diagonal_factor * diagonal_short_segments;
+                    }
+                    Segment diagonal(s.end(), other_s.start(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
             }
+            else if (other_s.slope() == std::numeric_limits<double>::infinity() && deq(s.slope(), 0))
+            {
+                if (other_s.start().y() > other_s.end().y())
+                {
+                    other_s.start().y() = other_s.start().y() -
+                        diagonal_factor * (std::fabs(other_s.start().y() - other_s.end().y()));
+                    if (s.end().x() > s.start().x())
+                    {
+                        s.end().x() = s.end().x() - diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
+                    }
+                    else
+                    {
+                        s.end().x() = s.end().x() + diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
+                    }
+                    Segment diagonal(s.end(), other_s.start(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+                else
+                {
+                    other_s.start().y() = other_s.start().y() +
+                        diagonal_factor * (std::fabs(other_s.start().y() - other_s.end().y()));
+                    if (s.end().x() > s.start().x())
+                    {
+                        s.end().x() = s.end().x() - diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
+                    }
+                    else
+                    {
+                        s.end().x() = s.end().x() + diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
+                    }
+                    Segment diagonal(s.end(), other_s.start(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+            }
+
+            return false;
         }
+        s.end() = other_s.end(); // extend end point
+        s.net_id() = std::max(s.net_id(), other_s.net_id());
+        other_s.start() = Coordinate(-1, -1, -1);
+        other_s.end() = Coordinate(-1, -1, -1);
+        return true;
+    }
+    else if (s.start().isCloseTo(other_s.end()))
+    {
+        if (fabs(s.slope() - other_s.slope()) > 5e-1)
+        {
+            other_s.net_id() = std::max(other_s.net_id(), s.net_id());
+            // 如果兩條線垂直(slope相乘等於-1), 連接的部分必須變成45度, s.start() 和 other_s.end() 連接
+            if (s.slope() == std::numeric_limits<double>::infinity() && deq(other_s.slope(), 0))
+            {
+                if (s.start().y() > s.end().y())
+                {
+                    s.start().y() = s.start().y() - diagonal_factor * diagonal_short_segments;
+                    if (other_s.end().x() > other_s.start().x())
+                    {
+                        other_s.end().x() = other_s.end().x() -
+                            diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
+                    }
+                    else
+                    {
+                        other_s.end().x() = other_s.end().x() +
+                            diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
+                    }
+                    Segment diagonal(s.start(), other_s.end(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+                else
+                {
+                    s.start().y() = s.start().y() + diagonal_factor * diagonal_short_segments;
+                    if (other_s.end().x() > other_s.start().x())
+                    {
+                        other_s.end().x() = other_s.end().x() -
+                            diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
+                    }
+                    else
+                    {
+                        other_s.end().x() = other_s.end().x() +
+                            diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
+                    }
+                    Segment diagonal(s.start(), other_s.end(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+            }
+            else if (other_s.slope() == std::numeric_limits<double>::infinity() && deq(s.slope(), 0))
+            {
+                if (other_s.end().y() > other_s.start().y())
+                {
+                    other_s.end().y() = other_s.end().y() -
+                        diagonal_factor * (std::fabs(other_s.end().y() - other_s.start().y()));
+                    if (s.start().x() > s.end().x())
+                    {
+                        s.start().x() = s.start().x() - diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
+                    }
+                    else
+                    {
+                        s.start().x() = s.start().x() + diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
+                    }
+                    Segment diagonal(s.start(), other_s.end(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+                else
+                {
+                    other_s.end().y() = other_s.end().y() +
+                        diagonal_factor * (std::fabs(other_s.end().y() - other_s.start().y()));
+                    if (s.start().x() > s.end().x())
+                    {
+                        s.start().x() = s.start().x() - diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
+                    }
+                    else
+                    {
+                        s.start().x() = s.start().x() + diagonal_factor * (std::fabs(s.start().x() - s.end().x()));
+                    }
+                    Segment diagonal(s.start(), other_s.end(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+            }
+
+            return false;
+        }
+        s.start() = other_s.start(); // update start point
+        s.net_id() = std::max(s.net_id(), other_s.net_id());
+        other_s.start() = Coordinate(-1, -1, -1);
+        other_s.end() = Coordinate(-1, -1, -1);
+        return true;
+    }
+    else if (s.end().isCloseTo(other_s.end()))
+    {
+        if (fabs(s.slope() - other_s.slope()) > 5e-1)
+        {
+            other_s.net_id() = std::max(other_s.net_id(), s.net_id());
+            // 如果兩條線垂直(slope相乘等於-1), 連接的部分必須變成45度, s.end() 和 other_s.end() 連接
+            if (s.slope() == std::numeric_limits<double>::infinity() && deq(other_s.slope(), 0))
+            {
+                if (s.end().y() > s.start().y())
+                {
+                    s.end().y() = s.end().y() - diagonal_factor * (std::fabs(s.end().y() - s.start().y()));
+                    if (other_s.end().x() > other_s.start().x())
+                    {
+                        other_s.end().x() = other_s.end().x() -
+                            diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
+                    }
+                    else
+                    {
+                        other_s.end().x() = other_s.end().x() +
+                            diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
+                    }
+                    Segment diagonal(s.end(), other_s.end(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+                else
+                {
+                    s.end().y() = s.end().y() + diagonal_factor * (std::fabs(s.end().y() - s.start().y()));
+                    if (other_s.end().x() > other_s.start().x())
+                    {
+                        other_s.end().x() = other_s.end().x() -
+                            diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
+                    }
+                    else
+                    {
+                        other_s.end().x() = other_s.end().x() +
+                            diagonal_factor * (std::fabs(other_s.end().x() - other_s.start().x()));
+                    }
+                    Segment diagonal(s.end(), other_s.end(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+            }
+            else if (other_s.slope() == std::numeric_limits<double>::infinity() && deq(s.slope(), 0))
+            {
+                if (other_s.end().y() > other_s.start().y())
+                {
+                    other_s.end().y() = other_s.end().y() -
+                        diagonal_factor * (std::fabs(other_s.end().y() - other_s.start().y()));
+                    if (s.end().x() > s.start().x())
+                    {
+                        s.end().x() = s.end().x() - diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
+                    }
+                    else
+                    {
+                        s.end().x() = s.end().x() + diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
+                    }
+                    Segment diagonal(s.end(), other_s.end(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+                else
+                {
+                    other_s.end().y() = other_s.end().y() +
+                        diagonal_factor * (std::fabs(other_s.end().y() - other_s.start().y()));
+                    if (s.end().x() > s.start().x())
+                    {
+                        s.end().x() = s.end().x() - diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
+                    }
+                    else
+                    {
+                        s.end().x() = s.end().x() + diagonal_factor * (std::fabs(s.end().x() - s.start().x()));
+                    }
+                    Segment diagonal(s.end(), other_s.end(), s.net_id());
+                    diagonals.push_back(diagonal);
+                }
+            }
+            return false;
+        }
+        s.end() = other_s.start(); // extend end point
+        s.net_id() = std::max(s.net_id(), other_s.net_id());
+        other_s.start() = Coordinate(-1, -1, -1);
+        other_s.end() = Coordinate(-1, -1, -1);
+        return true;
+    }
+    return false;
+}
+
+// Segments and vias that touch are one connected piece of wire and get the largest net_id among them
+void Router::setNetId()
+{
+    const size_t num_segments = m_segments.size();
+    // uniform grid over the segment bounding boxes (grown by the isOverlap epsilon), cells about a segment long
+    double cell = 0;
+    for (const auto &seg : m_segments)
+    {
+        cell += std::max(std::fabs(seg.end().x() - seg.start().x()), std::fabs(seg.end().y() - seg.start().y()));
+    }
+    cell = std::max(1.0, num_segments ? cell / num_segments : 0);
+    std::unordered_map<uint64_t, std::vector<size_t>> cells;
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        const auto &seg = m_segments[i];
+        long long x_min = std::floor((std::min(seg.start().x(), seg.end().x()) - 5e-1) / cell);
+        long long x_max = std::floor((std::max(seg.start().x(), seg.end().x()) + 5e-1) / cell);
+        long long y_min = std::floor((std::min(seg.start().y(), seg.end().y()) - 5e-1) / cell);
+        long long y_max = std::floor((std::max(seg.start().y(), seg.end().y()) + 5e-1) / cell);
+        for (long long x = x_min; x <= x_max; ++x)
+        {
+            for (long long y = y_min; y <= y_max; ++y)
+            {
+                cells[endpointKey(x, y, 0)].push_back(i);
+            }
+        }
+    }
+    const std::vector<size_t> none;
+    auto segmentsAt = [&](const Coordinate &p) -> const std::vector<size_t> &
+    {
+        auto it = cells.find(endpointKey(std::floor(p.x() / cell), std::floor(p.y() / cell), 0));
+        return it == cells.end() ? none : it->second;
+    };
+    // union-find over the segments followed by the vias
+    std::vector<size_t> parent(num_segments + m_vias.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](size_t x)
+    {
+        while (parent[x] != x)
+        {
+            x = parent[x] = parent[parent[x]];
+        }
+        return x;
+    };
+    for (size_t v = 0; v < m_vias.size(); ++v)
+    {
+        for (size_t i : segmentsAt(m_vias[v].coordinate()))
+        {
+            if (m_segments[i].isOverlap(m_vias[v]))
+            {
+                parent[find(num_segments + v)] = find(i);
+            }
+        }
+    }
+    for (size_t j = 0; j < num_segments; ++j)
+    {
+        for (const auto &end : {m_segments[j].start(), m_segments[j].end()})
+        {
+            for (size_t i : segmentsAt(end))
+            {
+                if (i != j && m_segments[i].isOverlap(end))
+                {
+                    parent[find(j)] = find(i);
+                }
+            }
+        }
+    }
+    // one pass takes the largest net_id of every piece and notes the pieces with more than one net
+    auto netId = [&](size_t x) -> int &
+    { return x < num_segments ? m_segments[x].net_id() : m_vias[x - num_segments].net_id(); };
+    std::vector<int> piece_net_id(parent.size(), -1);
+    std::string conflicts;
+    for (size_t x = 0; x < parent.size(); ++x)
+    {
+        int &net_id = piece_net_id[find(x)];
+        if (netId(x) != -1 && net_id != -1 && netId(x) != net_id)
+        {
+            conflicts += " (" + std::to_string(net_id) + ", " + std::to_string(netId(x)) + ")";
+        }
+        net_id = std::max(net_id, netId(x));
+    }
+    for (size_t x = 0; x < parent.size(); ++x)
+    {
+        netId(x) = piece_net_id[find(x)];
+    }
+    m_indexed = false;
+    if (!conflicts.empty())
+    {
+        throw std::runtime_error("Error: touching segments and vias of different nets:" + conflicts);
     }
 }
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "flow_network.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+size_t FlowNetwork::memoryUsage() const
+{
+    size_t bytes = (m_offsets.capacity() + m_heads.capacity() + m_capacities.capacity() + m_residuals.capacity() +
+                    m_costs.capacity() + m_pairs.capacity() + m_arcs.capacity() + m_slots.capacity() +
+                    m_tails.capacity() + m_predecessors.capacity()) *
+                   sizeof(int32_t);
+    bytes += m_pending.capacity() * sizeof(PendingArc);
+    bytes += (m_potentials.capacity() + m_distances.capacity()) * sizeof(int64_t) + m_done.capacity();
+    return bytes + m_heap.memoryUsage();
+}
+
+int32_t FlowNetwork::addArc(int32_t u, int32_t v, int32_t capacity, int32_t cost)
+{
+    if (u < 0 || u >= m_num_vertices || v < 0 || v >= m_num_vertices)
+    {
+        throw std::out_of_range("FlowNetwork addArc: vertex out of range " + std::to_string(u) + " -> " +
+                                std::to_string(v));
+    }
+    int32_t arc = numArcs();
+    m_tails.push_back(u);
+    m_tails.push_back(v);
+    m_pending.push_back(PendingArc{u, v, capacity, cost});
+    return arc;
+}
+
+void FlowNetwork::build()
+{
+    if (built())
+    {
+        return;
+    }
+    // gather every arc by id, the laid out ones keep their residuals
+    size_t num_built = m_slots.size();
+    size_t num_arcs = m_tails.size();
+    std::vector<int32_t> heads(num_arcs), capacities(num_arcs), residuals(num_arcs), costs(num_arcs);
+    for (size_t arc = 0; arc < num_built; ++arc)
+    {
+        int32_t slot = m_slots[arc];
+        heads[arc] = m_heads[slot];
+        capacities[arc] = m_capacities[slot];
+        residuals[arc] = m_residuals[slot];
+        costs[arc] = m_costs[slot];
+    }
+    for (size_t i = 0; i < m_pending.size(); ++i)
+    {
+        const auto &pending = m_pending[i];
+        size_t arc = num_built + 2 * i;
+        heads[arc] = pending.head;
+        capacities[arc] = pending.capacity;
+        residuals[arc] = pending.capacity;
+        costs[arc] = pending.cost;
+        heads[arc + 1] = pending.tail;
+        capacities[arc + 1] = 0;
+        residuals[arc + 1] = 0;
+        costs[arc + 1] = -pending.cost;
+    }
+    m_pending.clear();
+    // counting sort by tail, stable so the out arcs of a vertex stay in insertion order
+    m_offsets.assign(m_num_vertices + 1, 0);
+    for (int32_t tail : m_tails)
+    {
+        ++m_offsets[tail + 1];
+    }
+    for (int32_t u = 0; u < m_num_vertices; ++u)
+    {
+        m_offsets[u + 1] += m_offsets[u];
+    }
+    std::vector<int32_t> next(m_offsets.begin(), m_offsets.end() - 1);
+    m_arcs.resize(num_arcs);
+    m_slots.resize(num_arcs);
+    for (size_t arc = 0; arc < num_arcs; ++arc)
+    {
+        int32_t slot = next[m_tails[arc]]++;
+        m_arcs[slot] = static_cast<int32_t>(arc);
+        m_slots[arc] = slot;
+    }
+    m_heads.resize(num_arcs);
+    m_capacities.resize(num_arcs);
+    m_residuals.resize(num_arcs);
+    m_costs.resize(num_arcs);
+    m_pairs.resize(num_arcs);
+    for (size_t slot = 0; slot < num_arcs; ++slot)
+    {
+        int32_t arc = m_arcs[slot];
+        m_heads[slot] = heads[arc];
+        m_capacities[slot] = capacities[arc];
+        m_residuals[slot] = residuals[arc];
+        m_costs[slot] = costs[arc];
+        m_pairs[slot] = m_slots[arc ^ 1];
+    }
+}
+
+std::pair<int64_t, int64_t> FlowNetwork::minCostMaxFlow(int32_t s, int32_t t)
+{
+    const int64_t unreached = std::numeric_limits<int64_t>::max();
+    clearFlow();
+    m_potentials.assign(m_num_vertices, 0);
+    m_distances.resize(m_num_vertices);
+    m_predecessors.resize(m_num_vertices);
+    m_done.resize(m_num_vertices);
+    m_heap.reset(m_num_vertices);
+    int64_t total_flow = 0;
+    int64_t total_cost = 0;
+    while (true)
+    {
+        // Dijkstra on the residual arcs with reduced costs. It runs to the end and breaks ties like the Boost d-ary
+        // heap, stopping at t would leave other potentials and so pick other paths of the same cost
+        std::fill(m_distances.begin(), m_distances.end(), unreached);
+        std::fill(m_predecessors.begin(), m_predecessors.end(), -1);
+        std::fill(m_done.begin(), m_done.end(), 0);
+        m_distances[s] = 0;
+        m_heap.push(s, 0);
+        while (!m_heap.empty())
+        {
+            int32_t u = m_heap.pop();
+            m_done[u] = 1;
+            int64_t base = m_distances[u] + m_potentials[u];
+            for (int32_t slot = m_offsets[u]; slot < m_offsets[u + 1]; ++slot)
+            {
+                int32_t v = m_heads[slot];
+                if (m_residuals[slot] <= 0 || m_done[v])
+                {
+                    continue;
+                }
+                int64_t distance = base + m_costs[slot] - m_potentials[v];
+                if (distance < m_distances[v])
+                {
+                    m_distances[v] = distance;
+                    m_predecessors[v] = slot;
+                    m_heap.pushOrDecrease(v, distance);
+                }
+            }
+        }
+        if (m_predecessors[t] < 0)
+        {
+            break;
+        }
+        // a vertex out of reach stays out of reach, its potential is never read again
+        for (int32_t v = 0; v < m_num_vertices; ++v)
+        {
+            if (m_distances[v] != unreached)
+            {
+                m_potentials[v] += m_distances[v];
+            }
+        }
+        // push the bottleneck along the path
+        int32_t delta = std::numeric_limits<int32_t>::max();
+        for (int32_t v = t; v != s; v = m_heads[m_pairs[m_predecessors[v]]])
+        {
+            delta = std::min(delta, m_residuals[m_predecessors[v]]);
+        }
+        int64_t path_cost = 0;
+        for (int32_t v = t; v != s; v = m_heads[m_pairs[m_predecessors[v]]])
+        {
+            int32_t slot = m_predecessors[v];
+            m_residuals[slot] -= delta;
+            m_residuals[m_pairs[slot]] += delta;
+            path_cost += m_costs[slot];
+        }
+        total_flow += delta;
+        total_cost += delta * path_cost;
+    }
+    return {total_flow, total_cost};
+}
+
+void FlowNetwork::clearFlow()
+{
+    build();
+    std::copy(m_capacities.begin(), m_capacities.end(), m_residuals.begin());
+}
+
+int64_t FlowNetwork::maxFlow(int32_t s, int32_t t)
+{
+    build();
+    m_predecessors.resize(m_num_vertices);
+    std::vector<int32_t> queue;
+    queue.reserve(m_num_vertices);
+    int64_t total_flow = 0;
+    while (true)
+    {
+        std::fill(m_predecessors.begin(), m_predecessors.end(), -1);
+        queue.clear();
+        queue.push_back(s);
+        for (size_t front = 0; front < queue.size() && m_predecessors[t] < 0; ++front)
+        {
+            int32_t u = queue[front];
+            for (int32_t slot = m_offsets[u]; slot < m_offsets[u + 1]; ++slot)
+            {
+                int32_t v = m_heads[slot];
+                if (m_residuals[slot] > 0 && v != s && m_predecessors[v] < 0)
+                {
+                    m_predecessors[v] = slot;
+                    queue.push_back(v);
+                }
+            }
+        }
+        if (m_predecessors[t] < 0)
+        {
+            break;
+        }
+        int32_t delta = std::numeric_limits<int32_t>::max();
+        for (int32_t v = t; v != s; v = m_heads[m_pairs[m_predecessors[v]]])
+        {
+            delta = std::min(delta, m_residuals[m_predecessors[v]]);
+        }
+        for (int32_t v = t; v != s; v = m_heads[m_pairs[m_predecessors[v]]])
+        {
+            int32_t slot = m_predecessors[v];
+            m_residuals[slot] -= delta;
+            m_residuals[m_pairs[slot]] += delta;
+        }
+        total_flow += delta;
+    }
+    return total_flow;
+}
@@ -534,7 +534,7 @@ void GDTWriter::areaRoutingWithGrid()
         {
             for (int j = 0; j < grid->cols; ++j)
             {
-                if (grid->grid.at(i).at(j) == 1)
+                if (grid->isObstacle(i, j))
                 {
                     Coordinate start(bottom_left.x() + i * grid_width, bottom_left.y() + j * grid_width, 0);
                     Coordinate end(bottom_left.x() + (i + 1) * grid_width, bottom_left.y() + (j + 1) * grid_width, 0);
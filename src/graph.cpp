@@ -1,66 +1,42 @@
 #include "graph.hpp"
 #include "component_data.hpp"
+#include <algorithm>
 #include <cmath>
-#include <regex>
+#include <unordered_map>
 #ifdef VERBOSE
 #include <iostream>
 #endif
-void GraphManager::add_v(Graph &g, Traits::vertex_descriptor &v, std::string name)
+void GraphManager::add_v(int32_t &v, VertexInfo info)
 {
-    v = add_vertex(g);
-    m_vertex_names[v] = name;
+    v = m_network.addVertex();
+    m_vertex_infos[v] = info;
 }
-void GraphManager::add_v(Graph &g, TileNode &tile_node, std::string name)
+void GraphManager::add_v(TileNode &tile_node, int row, int column)
 {
-    tile_node.N() = add_vertex(g);
-    tile_node.S() = add_vertex(g);
-    tile_node.E() = add_vertex(g);
-    tile_node.W() = add_vertex(g);
-    tile_node.C() = add_vertex(g);
-    tile_node.d_C() = add_vertex(g);
-    m_vertex_names[tile_node.N()] = "N" + name;
-    m_vertex_names[tile_node.S()] = "S" + name;
-    m_vertex_names[tile_node.E()] = "E" + name;
-    m_vertex_names[tile_node.W()] = "W" + name;
-    m_vertex_names[tile_node.C()] = "C" + name;
-    m_vertex_names[tile_node.d_C()] = "dC" + name;
+    tile_node.N() = m_network.addVertex();
+    tile_node.S() = m_network.addVertex();
+    tile_node.E() = m_network.addVertex();
+    tile_node.W() = m_network.addVertex();
+    tile_node.C() = m_network.addVertex();
+    tile_node.d_C() = m_network.addVertex();
+    m_vertex_infos[tile_node.N()] = VertexInfo{VertexInfo::Kind::TILE, 'N', row, column};
+    m_vertex_infos[tile_node.S()] = VertexInfo{VertexInfo::Kind::TILE, 'S', row, column};
+    m_vertex_infos[tile_node.E()] = VertexInfo{VertexInfo::Kind::TILE, 'E', row, column};
+    m_vertex_infos[tile_node.W()] = VertexInfo{VertexInfo::Kind::TILE, 'W', row, column};
+    m_vertex_infos[tile_node.C()] = VertexInfo{VertexInfo::Kind::TILE, 'C', row, column};
+    m_vertex_infos[tile_node.d_C()] = VertexInfo{VertexInfo::Kind::DUMMY_CENTER, 0, row, column};
 }
-Graph GraphManager::reverseGraph(Graph &g)
-{
-    Graph rg;
-    graph_traits<Graph>::edge_iterator ei, ei_end;
-    for (tie(ei, ei_end) = edges(g); ei != ei_end; ++ei)
-    {
-        long flow = capacity[*ei] - residual_capacity[*ei];
-        if (flow > 0) // Show only edges with flow
-        {
-            Traits::vertex_descriptor u = source(*ei, g);
-            Traits::vertex_descriptor v = target(*ei, g);
-            auto e = add_edge(v, u, rg).first;
-            auto rev_e = add_edge(u, v, rg).first;
-            capacity[e] = flow;
-            weight[e] = -weight[*ei];
-            rev[e] = rev_e;
-            capacity[rev_e] = 0;
-            weight[rev_e] = weight[*ei];
-            rev[rev_e] = e;
-        }
-    }
-    return rg;
-}
-
 void GraphManager::fixFlowResults()
 {
-    graph_traits<Graph>::edge_iterator ei, ei_end;
-    for (tie(ei, ei_end) = edges(g); ei != ei_end; ++ei)
+    for (int32_t arc : m_network.arcs())
     {
-        int flow = capacity[*ei] - residual_capacity[*ei];
+        int flow = m_network.flow(arc);
         if (flow > 0)
         {
-            stored_capacity_and_residual[*ei] =
-                std::make_pair(capacity[*ei], residual_capacity[*ei]); // 记录原始的容量和残余容量
-            residual_capacity[rev[*ei]] = 0; // 确保反向边的残余容量设置正确
-            capacity[*ei] = 0; // 固定流量结果，防止后续计算修改
+            stored_capacity_and_residual[arc] =
+                std::make_pair(m_network.capacity(arc), m_network.residual(arc)); // 记录原始的容量和残余容量
+            m_network.setResidual(arc ^ 1, 0); // 确保反向边的残余容量设置正确
+            m_network.setCapacity(arc, 0);     // 固定流量结果，防止后续计算修改
         }
     }
 }
@@ -69,28 +45,20 @@ void GraphManager::restoreFlowResults()
 {
     for (const auto &pair : stored_capacity_and_residual)
     {
-        capacity[pair.first] = pair.second.first;
-        residual_capacity[pair.first] = pair.second.second;
+        m_network.setCapacity(pair.first, pair.second.first);
+        m_network.setResidual(pair.first, pair.second.second);
     }
 }
 
-void GraphManager::addSource2Pins(Component &component, std::unordered_set<int> &pinset)
+long GraphManager::addSource2Pins(Component &component, std::unordered_set<int> &pinset)
 
 // For DDR2DDR
 {
     int num_pin_rows = component.pin_arr().size();
     int num_pin_columns = component.pin_arr().at(0).size();
-    auto add_edge_with_capacity = [&](Traits::vertex_descriptor u, Traits::vertex_descriptor v, long cap, long cost)
-    {
-        auto e = add_edge(u, v, g).first;
-        auto rev_e = add_edge(v, u, g).first;
-        capacity[e] = cap;
-        weight[e] = cost;
-        rev[e] = rev_e;
-        capacity[rev_e] = 0;
-        weight[rev_e] = -cost;
-        rev[rev_e] = e;
-    };
+    long num_pins = 0;
+    auto add_edge_with_capacity = [&](int32_t u, int32_t v, long cap, long cost)
+    { m_network.addArc(u, v, static_cast<int32_t>(cap), static_cast<int32_t>(cost)); };
     // Source to Pins
     for (int i = 0; i < num_pin_rows; ++i)
     {
@@ -102,10 +70,12 @@ void GraphManager::addSource2Pins(Component &component, std::unordered_set<int>
                 {
 
                     add_edge_with_capacity(s, m_v.at(i).at(j), 1, 0);
+                    ++num_pins;
                 }
             }
         }
     }
+    return num_pins;
 }
 void GraphManager::DDR2DDRInit(DataManager &data_manager, Component &component, int expand, size_t maximum_layer)
 {
@@ -123,78 +93,63 @@ void GraphManager::DDR2DDRInit(DataManager &data_manager, Component &component,
     int num_layers = std::min(maximum_layer, data_manager.layers().size());
     int base_tile_row_idx = (!m_component->is_vertical_stack() ? expand : 0);
     int base_tile_column_idx = (m_component->is_vertical_stack() ? expand : 0);
+    m_base_tile_row = base_tile_row_idx;
+    m_base_tile_column = base_tile_column_idx;
     // Create the graph
-    g = Graph();
+    m_network = FlowNetwork();
     // Create the source and sink
     // Pin array is rows * columns
-    m_v = std::vector<std::vector<Traits::vertex_descriptor>>(num_pin_rows,
-                                                              std::vector<Traits::vertex_descriptor>(num_pin_columns));
+    m_v = std::vector<std::vector<int32_t>>(num_pin_rows, std::vector<int32_t>(num_pin_columns));
     // Tiles are (rows + 1 * columns + 1) * 6
     m_tiles = std::vector<std::vector<TileNode>>(num_tile_rows, std::vector<TileNode>(num_tile_columns));
-    m_rows = std::vector<std::vector<Traits::vertex_descriptor>>(num_tile_rows,
-                                                                 std::vector<Traits::vertex_descriptor>(num_layers));
-    m_d_rows = std::vector<std::vector<Traits::vertex_descriptor>>(num_tile_rows,
-                                                                   std::vector<Traits::vertex_descriptor>(num_layers));
+    m_rows = std::vector<std::vector<int32_t>>(num_tile_rows, std::vector<int32_t>(num_layers));
+    m_d_rows = std::vector<std::vector<int32_t>>(num_tile_rows, std::vector<int32_t>(num_layers));
     // Columns are (columns + 1) * layers * 2
-    m_columns = std::vector<std::vector<Traits::vertex_descriptor>>(num_tile_columns,
-                                                                    std::vector<Traits::vertex_descriptor>(num_layers));
-    m_d_columns = std::vector<std::vector<Traits::vertex_descriptor>>(
-        num_tile_columns, std::vector<Traits::vertex_descriptor>(num_layers));
+    m_columns = std::vector<std::vector<int32_t>>(num_tile_columns, std::vector<int32_t>(num_layers));
+    m_d_columns = std::vector<std::vector<int32_t>>(num_tile_columns, std::vector<int32_t>(num_layers));
     // All the vertex are
     // [num_pin_rows * num_pin_columns + (num_tile_rows * num_tile_columns * 6) + (num_tile_rows * num_layers * 2) + 2]
-    m_vertex_names =
-        std::vector<std::string>((num_pin_rows * num_pin_columns) + (num_tile_rows * num_tile_columns * 6) +
-                                 (num_tile_rows * num_layers * 2) + (num_tile_columns * num_layers * 2) + 2);
-    add_v(g, s, "s");
-    add_v(g, t, "t");
+    m_vertex_infos =
+        std::vector<VertexInfo>((num_pin_rows * num_pin_columns) + (num_tile_rows * num_tile_columns * 6) +
+                                (num_tile_rows * num_layers * 2) + (num_tile_columns * num_layers * 2) + 2);
+    add_v(s, VertexInfo{VertexInfo::Kind::SOURCE});
+    add_v(t, VertexInfo{VertexInfo::Kind::SINK});
 
     for (int i = 0; i < num_pin_rows; ++i)
     {
         for (int j = 0; j < num_pin_columns; ++j)
         {
-            add_v(g, m_v.at(i).at(j), "v" + std::to_string(i) + "_" + std::to_string(j));
+            add_v(m_v.at(i).at(j), VertexInfo{VertexInfo::Kind::PIN, 0, i, j});
         }
     }
     for (int i = 0; i < num_tile_rows; ++i)
     {
         for (int j = 0; j < num_tile_columns; ++j)
         {
-            add_v(g, m_tiles.at(i).at(j), std::to_string(i) + "_" + std::to_string(j));
+            add_v(m_tiles.at(i).at(j), i, j);
         }
     }
     for (int i = 0; i < num_tile_rows; ++i)
     {
         for (size_t j = 0; j < maximum_layer; ++j)
         {
-            add_v(g, m_rows.at(i).at(j), "r" + std::to_string(i) + "_" + std::to_string(j));
-            add_v(g, m_d_rows.at(i).at(j), "dr" + std::to_string(i) + "_" + std::to_string(j));
+            add_v(m_rows.at(i).at(j), VertexInfo{VertexInfo::Kind::ROW, 0, i, -1, static_cast<int>(j)});
+            add_v(m_d_rows.at(i).at(j), VertexInfo{VertexInfo::Kind::DUMMY_ROW, 0, i, -1, static_cast<int>(j)});
         }
     }
     for (int i = 0; i < num_tile_columns; ++i)
     {
         for (size_t j = 0; j < maximum_layer; ++j)
         {
-            add_v(g, m_columns.at(i).at(j), "c" + std::to_string(i) + "_" + std::to_string(j));
-            add_v(g, m_d_columns.at(i).at(j), "dc" + std::to_string(i) + "_" + std::to_string(j));
+            add_v(m_columns.at(i).at(j), VertexInfo{VertexInfo::Kind::COLUMN, 0, -1, i, static_cast<int>(j)});
+            add_v(m_d_columns.at(i).at(j),
+                  VertexInfo{VertexInfo::Kind::DUMMY_COLUMN, 0, -1, i, static_cast<int>(j)});
         }
     }
 
-    capacity = get(edge_capacity, g);
-    weight = get(edge_weight, g);
-    residual_capacity = get(edge_residual_capacity, g);
-    rev = get(edge_reverse, g);
 
-    auto add_edge_with_capacity = [&](Traits::vertex_descriptor u, Traits::vertex_descriptor v, long cap, long cost)
-    {
-        auto e = add_edge(u, v, g).first;
-        auto rev_e = add_edge(v, u, g).first;
-        capacity[e] = cap;
-        weight[e] = cost;
-        rev[e] = rev_e;
-        capacity[rev_e] = 0;
-        weight[rev_e] = -cost;
-        rev[rev_e] = e;
-    };
+    auto add_edge_with_capacity = [&](int32_t u, int32_t v, long cap, long cost)
+    { m_network.addArc(u, v, static_cast<int32_t>(cap), static_cast<int32_t>(cost)); };
     // Pin Array to periphery tiles
     for (int i = 0; i < num_pin_rows; ++i)
     {
@@ -329,6 +284,8 @@ void GraphManager::CPU2DDRInit(DataManager &data_manager,
     int num_tile_columns = component.columns() + 1;
     int base_tile_row_idx = 0;
     int base_tile_column_idx = 0;
+    m_base_tile_row = base_tile_row_idx;
+    m_base_tile_column = base_tile_column_idx;
     double tile_height_with_bump_ball = component.tile_height() - 2 * bump_ball_radius;
     double tile_width_with_bump_ball = component.tile_width() - 2 * bump_ball_radius;
     int o_hor_cap = std::floor(tile_height_with_bump_ball / (wire_spacing + wire_width));
@@ -344,52 +301,38 @@ void GraphManager::CPU2DDRInit(DataManager &data_manager,
 #endif
     // Create the graph
     // Create the graph
-    g = Graph();
+    m_network = FlowNetwork();
     // Create the source and sink
 
     // Pin array is rows * columns
-    m_v = std::vector<std::vector<Traits::vertex_descriptor>>(num_pin_rows,
-                                                              std::vector<Traits::vertex_descriptor>(num_pin_columns));
+    m_v = std::vector<std::vector<int32_t>>(num_pin_rows, std::vector<int32_t>(num_pin_columns));
     // Tiles are (rows + 1 * columns + 1) * 6
     m_tiles = std::vector<std::vector<TileNode>>(num_tile_rows, std::vector<TileNode>(num_tile_columns));
     // All the vertex are
     // [num_pin_rows * num_pin_columns + (num_tile_rows * num_tile_columns * 6) + (num_tile_rows * num_layers * 2) + 2]
-    m_vertex_names =
-        std::vector<std::string>((num_pin_rows * num_pin_columns) + (num_tile_rows * num_tile_columns * 6) + 2);
+    m_vertex_infos =
+        std::vector<VertexInfo>((num_pin_rows * num_pin_columns) + (num_tile_rows * num_tile_columns * 6) + 2);
 
-    add_v(g, s, "s");
-    add_v(g, t, "t");
+    add_v(s, VertexInfo{VertexInfo::Kind::SOURCE});
+    add_v(t, VertexInfo{VertexInfo::Kind::SINK});
     for (int i = 0; i < num_pin_rows; ++i)
     {
         for (int j = 0; j < num_pin_columns; ++j)
         {
-            add_v(g, m_v.at(i).at(j), "v" + std::to_string(i) + "_" + std::to_string(j));
+            add_v(m_v.at(i).at(j), VertexInfo{VertexInfo::Kind::PIN, 0, i, j});
         }
     }
     for (int i = 0; i < num_tile_rows; ++i)
     {
         for (int j = 0; j < num_tile_columns; ++j)
         {
-            add_v(g, m_tiles.at(i).at(j), std::to_string(i) + "_" + std::to_string(j));
+            add_v(m_tiles.at(i).at(j), i, j);
         }
     }
 
-    capacity = get(edge_capacity, g);
-    weight = get(edge_weight, g);
-    residual_capacity = get(edge_residual_capacity, g);
-    rev = get(edge_reverse, g);
 
-    auto add_edge_with_capacity = [&](Traits::vertex_descriptor u, Traits::vertex_descriptor v, long cap, long cost)
-    {
-        auto e = add_edge(u, v, g).first;
-        auto rev_e = add_edge(v, u, g).first;
-        capacity[e] = cap;
-        weight[e] = cost;
-        rev[e] = rev_e;
-        capacity[rev_e] = 0;
-        weight[rev_e] = -cost;
-        rev[rev_e] = e;
-    };
+    auto add_edge_with_capacity = [&](int32_t u, int32_t v, long cap, long cost)
+    { m_network.addArc(u, v, static_cast<int32_t>(cap), static_cast<int32_t>(cost)); };
     // Pin Array to periphery tiles
     for (int i = 0; i < num_pin_rows; ++i)
     {
@@ -513,30 +456,154 @@ void GraphManager::CPU2DDRInit(DataManager &data_manager,
     }
 }
 
-long GraphManager::minCostMaxFlow()
+uint64_t GraphManager::vertexKey(int32_t v) const
 {
-    // Calculate minimum cost maximum flow
-    successive_shortest_path_nonnegative_weights(g, s, t); // 直接用於求解最小費用最大流問題。
-    // 先用 Edmonds-Karp 求最大流，再用 Cycle Canceling 優化流量成本。
-    // edmonds_karp_max_flow(g, s, t);
-    // cycle_canceling(g);
+    const VertexInfo &info = m_vertex_infos[v];
+    int row = info.row;
+    int column = info.column;
+    // tiles, rows and columns count from the pin array, so expand does not move them
+    if (info.kind != VertexInfo::Kind::PIN)
+    {
+        row -= (row >= 0 ? m_base_tile_row : 0);
+        column -= (column >= 0 ? m_base_tile_column : 0);
+    }
+    auto field = [](int value) { return static_cast<uint64_t>(static_cast<uint16_t>(value)); };
+    return (static_cast<uint64_t>(info.kind) << 56) | (static_cast<uint64_t>(static_cast<uint8_t>(info.side)) << 48) |
+           (field(row) << 32) | (field(column) << 16) | field(info.layer);
+}
 
-    long cost = find_flow_cost(g);
-    long total_flow = 0;
-    graph_traits<Graph>::out_edge_iterator out_ei, out_e_end;
-    for (tie(out_ei, out_e_end) = out_edges(vertex(s, g), g); out_ei != out_e_end; ++out_ei)
+long GraphManager::seedFlow(const GraphManager &previous)
+{
+    std::unordered_map<uint64_t, int32_t> vertices;
+    vertices.reserve(m_network.numVertices());
+    for (int32_t v = 0; v < m_network.numVertices(); ++v)
     {
-        total_flow += capacity[*out_ei] - residual_capacity[*out_ei];
+        vertices.emplace(vertexKey(v), v);
     }
+    // flow left on the forward arcs of the previous network, taken apart into s -> t paths
+    const FlowNetwork &network = previous.m_network;
+    std::vector<int32_t> remaining(network.numArcs(), 0);
+    for (int32_t arc = 0; arc < network.numArcs(); arc += 2)
+    {
+        remaining[arc] = std::max(0, network.flow(arc));
+    }
+    std::vector<int32_t> position(network.numVertices(), -1); // index of the path arc leaving a vertex
+    std::vector<int32_t> path, arcs;
+    long seeded = 0;
+    while (true)
+    {
+        path.clear();
+        int32_t u = previous.s;
+        while (u != previous.t)
+        {
+            int32_t next = -1;
+            network.forEachOutArc(u,
+                                  [&](int32_t arc)
+                                  {
+                                      if (next < 0 && remaining[arc] > 0)
+                                      {
+                                          next = arc;
+                                      }
+                                  });
+            if (next < 0)
+            {
+                break;
+            }
+            position[u] = static_cast<int32_t>(path.size());
+            path.push_back(next);
+            u = network.head(next);
+            if (position[u] >= 0)
+            {
+                // cancel the cycle, it adds nothing to the flow
+                size_t first = position[u];
+                int32_t amount = remaining[path[first]];
+                for (size_t i = first; i < path.size(); ++i)
+                {
+                    amount = std::min(amount, remaining[path[i]]);
+                }
+                for (size_t i = first; i < path.size(); ++i)
+                {
+                    remaining[path[i]] -= amount;
+                    position[network.tail(path[i])] = -1;
+                }
+                path.resize(first);
+            }
+        }
+        for (int32_t arc : path)
+        {
+            position[network.tail(arc)] = -1;
+        }
+        if (u != previous.t)
+        {
+            break;
+        }
+        int32_t amount = remaining[path.front()];
+        for (int32_t arc : path)
+        {
+            amount = std::min(amount, remaining[arc]);
+        }
+        for (int32_t arc : path)
+        {
+            remaining[arc] -= amount;
+        }
+        // the same path in this network, dropped when a vertex or an arc is gone
+        arcs.clear();
+        for (int32_t arc : path)
+        {
+            auto tail = vertices.find(previous.vertexKey(network.tail(arc)));
+            auto head = vertices.find(previous.vertexKey(network.head(arc)));
+            if (tail == vertices.end() || head == vertices.end())
+            {
+                break;
+            }
+            int32_t found = -1;
+            m_network.forEachOutArc(tail->second,
+                                    [&](int32_t candidate)
+                                    {
+                                        if (found < 0 && candidate % 2 == 0 &&
+                                            m_network.head(candidate) == head->second &&
+                                            m_network.residual(candidate) >= amount)
+                                        {
+                                            found = candidate;
+                                        }
+                                    });
+            if (found < 0)
+            {
+                break;
+            }
+            arcs.push_back(found);
+        }
+        if (arcs.size() == path.size())
+        {
+            for (int32_t arc : arcs)
+            {
+                m_network.push(arc, amount);
+            }
+            seeded += amount;
+        }
+    }
+    return seeded;
+}
+
+long GraphManager::maxFlow(const GraphManager *previous)
+{
+    m_network.clearFlow();
+    long seeded = (previous ? seedFlow(*previous) : 0);
+    return seeded + m_network.maxFlow(s, t);
+}
+
+long GraphManager::minCostMaxFlow()
+{
+    // Calculate minimum cost maximum flow, successive shortest paths on the CSR network
+    auto [total_flow, cost] = m_network.minCostMaxFlow(s, t);
 
 #ifdef VERBOSE
     // Display flow on each edge
-    // graph_traits<Graph>::edge_iterator ei, ei_end;
-    // for (tie(ei, ei_end) = edges(g); ei != ei_end; ++ei)
+    // for (int32_t arc : m_network.arcs())
     // {
-    //     long flow = capacity[*ei] - residual_capacity[*ei];
+    //     long flow = m_network.flow(arc);
     //     if (flow > 0) // Show only edges with flow
-    //         std::cout << "Edge from " << m_vertex_names[source(*ei, g)] << " to " << m_vertex_names[target(*ei, g)]
+    //         std::cout << "Edge from " << m_network.tail(arc) << " to " << m_network.head(arc)
     //                   << " with flow " << flow << std::endl;
     // }
     // Display total flow and cost
@@ -549,12 +616,6 @@ long GraphManager::minCostMaxFlow()
 
 std::pair<Coordinate, Coordinate> GraphManager::DDR2DDR(std::shared_ptr<Router> router)
 {
-    std::regex vertex_pattern("v([0-9]{1,2})_([0-9]{1,2})");
-    std::regex tile_pattern("([NSEW])([0-9]{1,2})_([0-9]{1,2})");
-    std::regex d_tile_pattern("dC([0-9]{1,2})_([0-9]{1,2})");
-    std::regex row_pattern("r([0-9]{1,2})_([0-9]{1,2})");
-    std::regex column_pattern("c([0-9]{1,2})_([0-9]{1,2})");
-    std::smatch match_source, match_target;
     int shift_rows = m_rows.size() - m_v.size() - 1;
     int shift_columns = m_columns.size() - m_v.at(0).size() - 1;
     Coordinate tile_bottom_left = Coordinate(
@@ -562,93 +623,79 @@ std::pair<Coordinate, Coordinate> GraphManager::DDR2DDR(std::shared_ptr<Router>
         m_component->bottom_left().y() - (m_component->tile_height() / 2) - (shift_rows * m_component->tile_height()),
         m_component->bottom_left().z());
     std::unordered_map<int, int> row_or_col_via_count;
+    // segments of the flow edges, added to the router in one batch after the loop
+    std::vector<Segment> flow_segments;
     // Display flow on each edge
-    graph_traits<Graph>::edge_iterator ei, ei_end;
-    for (tie(ei, ei_end) = edges(g); ei != ei_end; ++ei)
+    for (int32_t arc : m_network.arcs())
     {
-        long flow = capacity[*ei] - residual_capacity[*ei];
+        long flow = m_network.flow(arc);
         if (flow > 0)
         {
-            std::string source_name = m_vertex_names[source(*ei, g)];
-            std::string target_name = m_vertex_names[target(*ei, g)];
-            // vertex to tile
-            if (std::regex_match(source_name, match_source, vertex_pattern) &&
-                std::regex_match(target_name, match_target, tile_pattern))
-            {
-                int s_i = std::stoi(match_source[1].str());
-                int s_j = std::stoi(match_source[2].str());
-                int t_i = std::stoi(match_target[2].str());
-                int t_j = std::stoi(match_target[3].str());
-                auto &pin_arr = m_component->pin_arr();
-                router->addSegment(Segment{pin_arr.at(s_i).at(s_j)->coordinate(),
-                                           Coordinate{tile_bottom_left.x() + (t_j * m_component->tile_width()),
-                                                      tile_bottom_left.y() + (t_i * m_component->tile_height()),
-                                                      tile_bottom_left.z()},
-                                           pin_arr.at(s_i).at(s_j)->net_id()});
-            }
-            // tile to tile
-            if (std::regex_match(source_name, match_source, tile_pattern) &&
-                std::regex_match(target_name, match_target, tile_pattern))
-            {
-                int s_i = std::stoi(match_source[2].str());
-                int s_j = std::stoi(match_source[3].str());
-                int t_i = std::stoi(match_target[2].str());
-                int t_j = std::stoi(match_target[3].str());
-                router->addSegment(Segment{Coordinate{tile_bottom_left.x() + (s_j * m_component->tile_width()),
-                                                      tile_bottom_left.y() + (s_i * m_component->tile_height()),
-                                                      tile_bottom_left.z()},
-                                           Coordinate{tile_bottom_left.x() + (t_j * m_component->tile_width()),
-                                                      tile_bottom_left.y() + (t_i * m_component->tile_height()),
-                                                      tile_bottom_left.z()},
-                                           -1});
-            }
-            // dummy center tile to row or column
-            if (std::regex_match(source_name, match_source, d_tile_pattern) &&
-                std::regex_match(target_name, match_target, row_pattern))
-            {
-                int s_i = std::stoi(match_source[1].str());
-                int s_j = std::stoi(match_source[2].str());
-                // int t_i = std::stoi(match_target[1].str());
-                int t_j = std::stoi(match_target[2].str());
-                router->addVia(Via{Coordinate{tile_bottom_left.x() + (s_j * m_component->tile_width()),
-                                              tile_bottom_left.y() + (s_i * m_component->tile_height()),
-                                              tile_bottom_left.z()},
-                                   t_j});
-                // // from via tace back to which pin
-                // for (auto &s : router->segments())
-                // {
-                // }
-            }
-            if (std::regex_match(source_name, match_source, d_tile_pattern) &&
-                std::regex_match(target_name, match_target, column_pattern))
+            const VertexInfo &from = m_vertex_infos[m_network.tail(arc)];
+            const VertexInfo &to = m_vertex_infos[m_network.head(arc)];
+            switch (from.kind)
             {
-                int s_i = std::stoi(match_source[1].str());
-                int s_j = std::stoi(match_source[2].str());
-                // int t_i = std::stoi(match_target[1].str());
-                int t_j = std::stoi(match_target[2].str());
-                router->addVia(Via{Coordinate{tile_bottom_left.x() + (s_j * m_component->tile_width()),
-                                              tile_bottom_left.y() + (s_i * m_component->tile_height()),
-                                              tile_bottom_left.z()},
-                                   t_j});
+            case VertexInfo::Kind::PIN:
+                // vertex to tile
+                if (to.kind == VertexInfo::Kind::TILE && to.side != 'C')
+                {
+                    auto &pin_arr = m_component->pin_arr();
+                    flow_segments.emplace_back(
+                        pin_arr.at(from.row).at(from.column)->coordinate(),
+                        Coordinate{tile_bottom_left.x() + (to.column * m_component->tile_width()),
+                                   tile_bottom_left.y() + (to.row * m_component->tile_height()),
+                                   tile_bottom_left.z()},
+                        pin_arr.at(from.row).at(from.column)->net_id());
+                }
+                break;
+            case VertexInfo::Kind::TILE:
+                // tile to tile
+                if (from.side != 'C' && to.kind == VertexInfo::Kind::TILE && to.side != 'C')
+                {
+                    flow_segments.emplace_back(
+                        Coordinate{tile_bottom_left.x() + (from.column * m_component->tile_width()),
+                                   tile_bottom_left.y() + (from.row * m_component->tile_height()),
+                                   tile_bottom_left.z()},
+                        Coordinate{tile_bottom_left.x() + (to.column * m_component->tile_width()),
+                                   tile_bottom_left.y() + (to.row * m_component->tile_height()),
+                                   tile_bottom_left.z()},
+                        -1);
+                }
+                break;
+            case VertexInfo::Kind::DUMMY_CENTER:
+                // dummy center tile to row or column
+                if (to.kind == VertexInfo::Kind::ROW || to.kind == VertexInfo::Kind::COLUMN)
+                {
+                    router->addVia(Via{Coordinate{tile_bottom_left.x() + (from.column * m_component->tile_width()),
+                                                  tile_bottom_left.y() + (from.row * m_component->tile_height()),
+                                                  tile_bottom_left.z()},
+                                       to.layer});
+                }
+                break;
+            default:
+                break;
             }
         }
     }
+    router->addSegments(flow_segments);
     // After via assignment, assign edges to boundary
-    for (tie(ei, ei_end) = edges(g); ei != ei_end; ++ei)
+    for (int32_t arc : m_network.arcs())
     {
-        long flow = capacity[*ei] - residual_capacity[*ei];
+        long flow = m_network.flow(arc);
         if (flow > 0)
         {
-            std::string source_name = m_vertex_names[source(*ei, g)];
-            std::string target_name = m_vertex_names[target(*ei, g)];
+            const VertexInfo &from = m_vertex_infos[m_network.tail(arc)];
+            const VertexInfo &to = m_vertex_infos[m_network.head(arc)];
+            if (from.kind != VertexInfo::Kind::DUMMY_CENTER)
+            {
+                continue;
+            }
+            int s_i = from.row;
+            int s_j = from.column;
+            int t_j = to.layer;
             // dummy center tile to row or column
-            if (std::regex_match(source_name, match_source, d_tile_pattern) &&
-                std::regex_match(target_name, match_target, row_pattern))
+            if (to.kind == VertexInfo::Kind::ROW)
             {
-                int s_i = std::stoi(match_source[1].str());
-                int s_j = std::stoi(match_source[2].str());
-                // int t_i = std::stoi(match_target[1].str());
-                int t_j = std::stoi(match_target[2].str());
                 // set wire bound
                 m_component->wire_bound().at(0) = tile_bottom_left.x() - m_component->tile_width();
                 m_component->wire_bound().at(1) =
@@ -717,13 +764,8 @@ std::pair<Coordinate, Coordinate> GraphManager::DDR2DDR(std::shared_ptr<Router>
                     router->addSegment(Segment{first_bend, right_bound, -1});
                 }
             }
-            if (std::regex_match(source_name, match_source, d_tile_pattern) &&
-                std::regex_match(target_name, match_target, column_pattern))
+            if (to.kind == VertexInfo::Kind::COLUMN)
             {
-                int s_i = std::stoi(match_source[1].str());
-                int s_j = std::stoi(match_source[2].str());
-                // int t_i = std::stoi(match_target[1].str());
-                int t_j = std::stoi(match_target[2].str());
                 // set wire bound
                 m_component->wire_bound().at(0) = tile_bottom_left.y() +
                                                   (m_component->tile_height() * (m_component->rows() + shift_rows)) +
@@ -1197,10 +1239,6 @@ void tileDetailedRoute(std::shared_ptr<Router> router,
 }
 void GraphManager::CPU2DDR(std::shared_ptr<Router> router, Component &component, std::string escape_boundary)
 {
-    std::regex vertex_pattern("v([0-9]{1,2})_([0-9]{1,2})");
-    std::regex tile_pattern("([NSEWC])([0-9]{1,2})_([0-9]{1,2})");
-    std::regex d_tile_pattern("dC([0-9]{1,2})_([0-9]{1,2})");
-    std::smatch match_source, match_target;
     Coordinate tile_bottom_left = Coordinate(component.bottom_left().x() - component.tile_width(),
                                              component.bottom_left().y() - component.tile_height(),
                                              component.bottom_left().z());
@@ -1232,70 +1270,65 @@ void GraphManager::CPU2DDR(std::shared_ptr<Router> router, Component &component,
     // 0 - s, 1 - t
     // 2 vertices
     // # of pin + 2 - tiles
-    graph_traits<Graph>::edge_iterator ei, ei_end;
-    for (tie(ei, ei_end) = edges(g); ei != ei_end; ++ei)
+    for (int32_t arc : m_network.arcs())
     {
-        long flow = capacity[*ei] - residual_capacity[*ei];
+        long flow = m_network.flow(arc);
         if (flow > 0)
         {
-            std::string source_name = m_vertex_names[source(*ei, g)];
-            std::string target_name = m_vertex_names[target(*ei, g)];
-            if (std::regex_match(source_name, match_source, tile_pattern) &&
-                std::regex_match(target_name, match_target, tile_pattern))
+            const VertexInfo &from = m_vertex_infos[m_network.tail(arc)];
+            const VertexInfo &to = m_vertex_infos[m_network.head(arc)];
+            if (from.kind == VertexInfo::Kind::TILE && to.kind == VertexInfo::Kind::TILE)
             {
-                int s_i = std::stoi(match_source[2].str());
-                int s_j = std::stoi(match_source[3].str());
-                int t_i = std::stoi(match_target[2].str());
-                int t_j = std::stoi(match_target[3].str());
-                if (match_source[1].str() == "N" && match_target[1].str() == "S")
+                int s_i = from.row;
+                int s_j = from.column;
+                int t_i = to.row;
+                int t_j = to.column;
+                if (from.side == 'N' && to.side == 'S')
                 {
                     v_tmp_tiles.at(s_i).at(s_j).direction[N][OUT] += flow;
                     v_tmp_tiles.at(t_i).at(t_j).direction[S][IN] += flow;
                 }
-                if (match_source[1].str() == "S" && match_target[1].str() == "N")
+                if (from.side == 'S' && to.side == 'N')
                 {
                     v_tmp_tiles.at(s_i).at(s_j).direction[S][OUT] += flow;
                     v_tmp_tiles.at(t_i).at(t_j).direction[N][IN] += flow;
                 }
-                if (match_source[1].str() == "E" && match_target[1].str() == "W")
+                if (from.side == 'E' && to.side == 'W')
                 {
                     v_tmp_tiles.at(s_i).at(s_j).direction[E][OUT] += flow;
                     v_tmp_tiles.at(t_i).at(t_j).direction[W][IN] += flow;
                 }
-                if (match_source[1].str() == "W" && match_target[1].str() == "E")
+                if (from.side == 'W' && to.side == 'E')
                 {
                     v_tmp_tiles.at(s_i).at(s_j).direction[W][OUT] += flow;
                     v_tmp_tiles.at(t_i).at(t_j).direction[E][IN] += flow;
                 }
             }
-            if (std::regex_match(source_name, match_source, vertex_pattern) &&
-                std::regex_match(target_name, match_target, tile_pattern))
+            if (from.kind == VertexInfo::Kind::PIN && to.kind == VertexInfo::Kind::TILE)
             {
-                // int s_i = std::stoi(match_source[1].str());
-                // int s_j = std::stoi(match_source[2].str());
-                int t_i = std::stoi(match_target[2].str());
-                int t_j = std::stoi(match_target[3].str());
-                if (match_target[1].str() == "N")
+                int t_i = to.row;
+                int t_j = to.column;
+                if (to.side == 'N')
                 {
                     v_tmp_tiles.at(t_i).at(t_j).pins[N] = true;
                 }
-                if (match_target[1].str() == "S")
+                if (to.side == 'S')
                 {
                     v_tmp_tiles.at(t_i).at(t_j).pins[S] = true;
                 }
-                if (match_target[1].str() == "E")
+                if (to.side == 'E')
                 {
                     v_tmp_tiles.at(t_i).at(t_j).pins[E] = true;
                 }
-                if (match_target[1].str() == "W")
+                if (to.side == 'W')
                 {
                     v_tmp_tiles.at(t_i).at(t_j).pins[W] = true;
                 }
             }
-            if (std::regex_match(source_name, match_source, vertex_pattern) && target_name == "t")
+            if (from.kind == VertexInfo::Kind::PIN && to.kind == VertexInfo::Kind::SINK)
             {
-                int s_i = std::stoi(match_source[1].str());
-                int s_j = std::stoi(match_source[2].str());
+                int s_i = from.row;
+                int s_j = from.column;
                 Coordinate pin_bottom_left =
                     Coordinate(component.bottom_left().x(), component.bottom_left().y(), component.bottom_left().z());
                 // find pin
@@ -1359,10 +1392,10 @@ void GraphManager::CPU2DDR(std::shared_ptr<Router> router, Component &component,
                     throw std::runtime_error("Invalid escape boundary character");
                 }
             }
-            if (std::regex_match(source_name, match_source, tile_pattern) && target_name == "t")
+            if (from.kind == VertexInfo::Kind::TILE && to.kind == VertexInfo::Kind::SINK)
             {
-                int s_i = std::stoi(match_source[2].str());
-                int s_j = std::stoi(match_source[3].str());
+                int s_i = from.row;
+                int s_j = from.column;
                 if (escape_boundary.find('N') != std::string::npos)
                 {
                     v_tmp_tiles.at(s_i).at(s_j).direction[N][OUT] += flow;
@@ -1,27 +1,10 @@
 #include "grid.hpp"
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
 #include <queue>
-#include <unordered_map>
 using namespace A_Star;
-Point getDirection(const Point &prev, const Point &current)
-{
-    if (prev == Point(-1, -1))
-    {
-        return Point(0, 0);
-    }
-    return Point(current.x - prev.x, current.y - prev.y);
-}
-
-bool sameDirection(const Point &prev, const Point &current, const Point &new_direction)
-{
-    if (prev == Point(-1, -1))
-    {
-        return true;
-    }
-    Point direction(current.x - prev.x, current.y - prev.y);
-    return direction == new_direction;
-}
-
 std::vector<Point> Grid::get_valid_directions(const Point &prev, const Point &current)
 {
     if (prev == Point(-1, -1))
@@ -65,107 +48,877 @@ std::vector<Point> Grid::get_valid_directions(const Point &prev, const Point &cu
 }
 
 // A* start and goal are in Coordinate type, and Call the a_star_search function with Point type
-std::vector<Point> Grid::a_star_search(const Coordinate &start, const Coordinate &goal, const Point &parent_direction)
+std::vector<Point> Grid::a_star_search(const Coordinate &start,
+                                       const Coordinate &goal,
+                                       const Point &parent_direction,
+                                       const std::optional<Window> &corridor,
+                                       const Region *region)
+{
+    Point start_point = toPoint(start);
+    Point goal_point = toPoint(goal);
+    return a_star_search(start_point, goal_point, Point(start_point + parent_direction), corridor, region);
+}
+
+namespace
+{
+// Open list adapters, so the same search loop runs on the binary heap and on the radix heap
+struct HeapOpenList
+{
+    IndexedHeap<SearchKey> &heap;
+    StepCosts costs;
+    void reset(size_t num_states) { heap.reset(num_states); }
+    bool empty() const { return heap.empty(); }
+    int32_t pop() { return heap.pop(); }
+    void push(int32_t state, double f, double g) { heap.pushOrDecrease(state, SearchKey{f, g}); }
+};
+
+struct RadixOpenList
+{
+    RadixHeap<int32_t> &heap;
+    StepCosts costs;
+    void reset(size_t) { heap.clear(); }
+    bool empty() const { return heap.empty(); }
+    int32_t pop() { return heap.pop(); }
+    // no decrease-key, the stale entry is skipped once the state is closed
+    void push(int32_t state, double f, double) { heap.push(static_cast<uint64_t>(f), state); }
+};
+
+// Whether goal lies on the ray from p in direction d or in one of its two 45 degree turns, a jump has to stop there
+// so the route can turn towards the goal
+bool onGoalRay(const Point &p, int direction, const Point &goal)
 {
-    Point start_point((start.x() - bottom_left.x()) / grid_width, (start.y() - bottom_left.y()) / grid_width);
-    Point goal_point((goal.x() - bottom_left.x()) / grid_width, (goal.y() - bottom_left.y()) / grid_width);
-    return a_star_search(start_point, goal_point, Point(start_point + parent_direction));
+    const int dx = goal.x - p.x;
+    const int dy = goal.y - p.y;
+    for (int turn : {0, 1, 7})
+    {
+        const Point &d = direction_table[(direction + turn) & 7];
+        if (d.x == 0 ? dx == 0 && dy * d.y > 0
+                     : (d.y == 0 ? dy == 0 && dx * d.x > 0 : dx * d.x > 0 && dx * d.x == dy * d.y))
+        {
+            return true;
+        }
+    }
+    return false;
 }
+} // namespace
 
 // start point with parent, and goal point, and return the path
-std::vector<Point> Grid::a_star_search(Point start, Point goal, const Point &parent)
-{
-    int rows = grid.size();
-    int cols = grid[0].size();
-    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> open_list;
-    open_list.emplace(start, 0, heuristic(start, goal), parent);
-    std::unordered_map<Point, Point, PointHash> came_from;
-    std::unordered_map<Point, double, PointHash> cost_so_far;
-    cost_so_far[start] = 0;
+// The search never leaves the grid window, or the corridor and the coarse cells of region when they are given.
+// hit_window_edge tells the caller whether one of these bounds was in the way, so it can retry with a larger one.
+std::vector<Point> Grid::a_star_search(
+    Point start, Point goal, const Point &parent, const std::optional<Window> &corridor, const Region *region)
+{
+    hit_window_edge = false;
+    const SearchBounds bounds(corridor ? window().intersect(*corridor) : window(), region);
+    if (bidirectional)
+    {
+        return bidirectional_a_star_search(start, goal, parent, bounds);
+    }
+    if (integer_cost)
+    {
+        return a_star_search(start, goal, parent, bounds, RadixOpenList{radix_list, stepCosts()});
+    }
+    return a_star_search(start, goal, parent, bounds, HeapOpenList{open_list, stepCosts()});
+}
+
+// Dijkstra from goal over the reversed moves of a_star_search. Adding an obstacle only makes the true distances
+// longer, so a field stays a lower bound until an obstacle is removed.
+const DistanceField *Grid::distanceField(const Point &goal)
+{
+    if (!distance_heuristic)
+    {
+        return nullptr;
+    }
+    const int32_t goal_cell = cellIndex(goal);
+    DistanceField &field = distance_fields[goal_cell];
+    field.last_used = ++cache_clock;
+    if (field.computed && field.obstacle_version == obstacle_version && field.integer_cost == integer_cost)
+    {
+        return &field;
+    }
+    // a field costs more than one search, so a goal only gets one when it is searched again
+    if (++field.searches < 2)
+    {
+        return nullptr;
+    }
+    field.computed = true;
+    field.reached = ObstaclePlane(rows, cols);
+    field.distance.resize(layout.size());
+    field.obstacle_version = obstacle_version;
+    field.integer_cost = integer_cost;
+    const StepCosts costs = stepCosts();
+    using Entry = std::pair<double, int32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    field.reached.set(goal.x, goal.y);
+    field.distance.set(goal_cell, 0);
+    queue.emplace(0, goal_cell);
+    while (!queue.empty())
+    {
+        const auto [distance, cell] = queue.top();
+        queue.pop();
+        if (distance > field.distance[cell])
+        {
+            continue;
+        }
+        const Point n = cellPoint(cell);
+        for (int direction = 0; direction < 8; ++direction)
+        {
+            // the move from m into n, allowed under the same rules as in a_star_search
+            const Point &d = direction_table[direction];
+            const Point m(n.x - d.x, n.y - d.y);
+            if (!inBounds(m) || isObstacle(m))
+            {
+                continue;
+            }
+            const bool diagonal = d.x != 0 && d.y != 0;
+            if (diagonal && isObstacle(m.x, n.y) && isObstacle(n.x, m.y))
+            {
+                continue;
+            }
+            const double next = distance + (diagonal ? costs.diagonal : costs.straight);
+            const int32_t previous = cellIndex(m);
+            if (!field.reached.test(m.x, m.y) || next < field.distance[previous])
+            {
+                field.reached.set(m.x, m.y);
+                field.distance.set(previous, next);
+                queue.emplace(next, previous);
+            }
+        }
+    }
+
+    // keep the fields inside the memory budget, the least recently used go first
+    size_t usage = 0;
+    for (const auto &f : distance_fields)
+    {
+        usage += f.second.memoryUsage();
+    }
+    while (usage > distance_field_budget && distance_fields.size() > 1)
+    {
+        auto oldest = distance_fields.end();
+        for (auto f = distance_fields.begin(); f != distance_fields.end(); ++f)
+        {
+            if (f->first != goal_cell &&
+                (oldest == distance_fields.end() || f->second.last_used < oldest->second.last_used))
+            {
+                oldest = f;
+            }
+        }
+        usage -= oldest->second.memoryUsage();
+        distance_fields.erase(oldest);
+    }
+    return &field;
+}
+
+// The search runs on (cell, incoming direction) states, because the allowed moves and the bend cost both depend on
+// the direction a cell was entered from. Every state is expanded at most once.
+// With jump_search a move keeps going straight while the cell it reaches is clear (no obstacle or cost around it) and
+// the goal is not in sight, so only the cells where something changes become states. A turn in the middle of an open
+// run costs the same bend wherever it happens, the run just ends where turning can matter.
+template <typename OpenList>
+std::vector<Point>
+Grid::a_star_search(Point start, Point goal, const Point &parent, const SearchBounds &bounds, OpenList queue)
+{
+    const StepCosts &costs = queue.costs;
+    if (!bounds.contains(start) || !bounds.contains(goal))
+    {
+        hit_window_edge = true;
+        return {};
+    }
     // mark start and goal point grid as 0
-    grid[start.x][start.y] = 0;
-    grid[goal.x][goal.y] = 0;
-    // count 如果超過 grid 的一半 就不要走了
-    int count = 0;
-    while (!open_list.empty())
+    clearObstacle(start);
+    clearObstacle(goal);
+    if (start == goal)
     {
-        // 正常A_Star不需要這個部分，單純加速過濾掉繞不出來的訊號
-        count++;
-        if (count > rows * cols / 2)
+        return {start};
+    }
+    // parent (-1, -1) means the start can leave in any direction without a bend
+    const bool free_start = parent == Point(-1, -1);
+    int start_direction = directionIndex(Point(start.x - parent.x, start.y - parent.y));
+    if (start_direction < 0)
+    {
+        if (!free_start)
         {
             return {};
         }
+        start_direction = 0;
+    }
+
+    // cells the distance field did not reach are cut off from the goal, the search there keeps the octile estimate
+    // so it still finds out whether the window edge was in the way
+    const DistanceField *field = distanceField(goal);
+    auto heuristic = [&](const Point &p)
+    {
+        return field != nullptr && field->reached.test(p.x, p.y) ? field->distance[cellIndex(p)]
+                                                                 : costs.heuristic(p, goal);
+    };
 
-        Node current = open_list.top();
-        open_list.pop();
-        if (came_from.find(current.point) != came_from.end() && current.cost > cost_so_far[current.point])
+    const size_t num_states = numStates();
+    const size_t max_expansions = static_cast<size_t>(rows) * cols * 4; // half of the states of the grid
+    workspace.begin(num_states);
+    queue.reset(num_states);
+    const int32_t start_state = stateIndex(cellIndex(start), start_direction);
+    workspace.relax(start_state, 0, -1);
+    queue.push(start_state, heuristic(start), 0);
+    // count 如果超過 state 數量的一半 就不要走了 (grid 只涵蓋 routing window)
+    size_t count = 0;
+    while (!queue.empty())
+    {
+        const int32_t current_state = queue.pop();
+        if (workspace.isClosed(current_state))
         {
             continue;
         }
-        came_from[current.point] = current.parent;
+        workspace.close(current_state);
+        // 正常A_Star不需要這個部分，單純加速過濾掉繞不出來的訊號
+        count++;
+        if (count > max_expansions)
+        {
+            return {};
+        }
+        const int32_t current_cell = current_state >> 3;
+        const int current_direction = current_state & 7;
+        const Point current = cellPoint(current_cell);
+        const double current_cost = workspace.cost(current_state);
 
-        if (current.point == goal)
+        if (current == goal)
         {
             std::vector<Point> path;
-            Point temp = current.point;
-            // 計算轉彎的數量
-            int bend = 0;
-            Point pre_direction = Point(-1, -1);
-            while (temp.x != parent.x || temp.y != parent.y)
-            {
-                path.push_back(temp);
-                temp = came_from[temp];
-                // 計算轉彎的數量
-                Point temp_direction = getDirection(temp, came_from[temp]);
-                if (!(temp_direction == pre_direction))
+            for (int32_t temp = current_state; temp != -1; temp = workspace.parent(temp))
+            {
+                // a jumped state is several steps away from its parent, fill in the cells in between
+                const Point &d = direction_table[temp & 7];
+                const int32_t parent_state = workspace.parent(temp);
+                Point p = cellPoint(temp >> 3);
+                path.push_back(p);
+                for (p = Point(p.x - d.x, p.y - d.y); parent_state != -1 && !(p == cellPoint(parent_state >> 3));
+                     p = Point(p.x - d.x, p.y - d.y))
                 {
-                    bend++;
-                };
-                pre_direction = temp_direction;
+                    path.push_back(p);
+                }
             }
-#ifdef VERBOSE
-            // std::cout << "Bend: " << bend << std::endl;
-#endif
             std::reverse(path.begin(), path.end());
             return path;
         }
 
-        for (const auto &d : get_valid_directions(current.parent, current.point))
+        const bool any_direction = free_start && current_state == start_state;
+        for (int turn = 0; turn < (any_direction ? 8 : 3); ++turn)
         {
-            Point neighbor(current.point.x + d.x, current.point.y + d.y);
-
-            if (neighbor.x >= 0 && neighbor.x < rows && neighbor.y >= 0 && neighbor.y < cols &&
-                grid[neighbor.x][neighbor.y] == 0)
+            // keep going straight first, then the two 45 degree turns
+            const int direction = any_direction ? turn : (current_direction + (turn == 2 ? 7 : turn)) & 7;
+            const Point &d = direction_table[direction];
+            Point neighbor(current.x + d.x, current.y + d.y);
+            if (!bounds.contains(neighbor))
+            {
+                hit_window_edge = true;
+                continue;
+            }
+            if (isObstacle(neighbor))
             {
-                if (d.x != 0 && d.y != 0)
+                continue;
+            }
+            if (d.x != 0 && d.y != 0)
+            {
+                if (isObstacle(current.x, neighbor.y) && isObstacle(neighbor.x, current.y))
+                {
+                    continue;
+                }
+            }
+            const double step = (d.x != 0 && d.y != 0) ? costs.diagonal : costs.straight;
+            double new_cost = current_cost + step + costs.cell(cost(neighbor));
+            if (jump_search)
+            {
+                // a clear cell has free, zero-cost neighbors, so the next step needs no further checks
+                while (!(neighbor == goal) && isClear(neighbor, bounds) && !onGoalRay(neighbor, direction, goal))
                 {
-                    if (grid[current.point.x][neighbor.y] == 1 && grid[neighbor.x][current.point.y] == 1)
-                    {
-                        continue;
-                    }
+                    neighbor = neighbor + d;
+                    new_cost += step;
                 }
+            }
+            const int32_t neighbor_state = stateIndex(cellIndex(neighbor), direction);
+            if (workspace.isClosed(neighbor_state))
+            {
+                continue;
+            }
+
+            // I want to keep the original direction, the cost will be lower
+            if (!any_direction && direction != current_direction)
+            {
+                new_cost += costs.bend;
+            }
+
+            if (!workspace.hasCost(neighbor_state) || new_cost < workspace.cost(neighbor_state))
+            {
+                workspace.relax(neighbor_state, new_cost, current_state);
+                queue.push(neighbor_state, new_cost + heuristic(neighbor), new_cost);
+            }
+        }
+    }
+
+    return {};
+}
+
+// Bidirectional variant on the same (cell, incoming direction) states. The backward search runs on the reversed
+// edges: state (c, d) is reached from (c - d, d) and from (c - d, d +- 45) with the bend charged on the same edge as
+// the forward search, and it starts from every incoming direction at goal. The forward start state keeps the
+// direction given by parent, so a meeting at the start cell has to use that direction.
+// Both sides use the average potential p(v) = (h_goal(v) - h_start(v)) / 2 (negated for the backward side), which is
+// consistent for both directions, so the search can stop once the two smallest keys add up to the best meeting cost.
+std::vector<Point>
+Grid::bidirectional_a_star_search(Point start, Point goal, const Point &parent, const SearchBounds &bounds)
+{
+    if (!bounds.contains(start) || !bounds.contains(goal))
+    {
+        hit_window_edge = true;
+        return {};
+    }
+    // mark start and goal point grid as 0
+    clearObstacle(start);
+    clearObstacle(goal);
+    if (start == goal)
+    {
+        return {start};
+    }
+    const bool free_start = parent == Point(-1, -1);
+    int start_direction = directionIndex(Point(start.x - parent.x, start.y - parent.y));
+    if (start_direction < 0)
+    {
+        if (!free_start)
+        {
+            return {};
+        }
+        start_direction = 0;
+    }
 
-                double new_cost =
-                    current.cost + ((d.x != 0 && d.y != 0) ? sqrt(2) : 1) + cost_grid[neighbor.x][neighbor.y];
+    const StepCosts costs = stepCosts();
+    const size_t num_states = numStates();
+    const size_t max_expansions = static_cast<size_t>(rows) * cols * 4; // half of the states of the grid
+    workspace.begin(num_states);
+    open_list.reset(num_states);
+    reverse_workspace.begin(num_states);
+    reverse_open_list.reset(num_states);
+    const int32_t start_state = stateIndex(cellIndex(start), start_direction);
+    auto potential = [&](const Point &p) { return (costs.heuristic(p, goal) - costs.heuristic(start, p)) / 2; };
+    workspace.relax(start_state, 0, -1);
+    open_list.push(start_state, SearchKey{potential(start), 0});
+    for (int d = 0; d < 8; ++d)
+    {
+        const int32_t goal_state = stateIndex(cellIndex(goal), d);
+        reverse_workspace.relax(goal_state, 0, -1);
+        reverse_open_list.push(goal_state, SearchKey{-potential(goal), 0});
+    }
 
-                // I want to keep the original direction, the cost will be lower
-                if (!sameDirection(current.parent, current.point, d))
+    double best_cost = std::numeric_limits<double>::max();
+    int32_t meeting_state = -1;
+    auto meet = [&](int32_t state)
+    {
+        if (workspace.hasCost(state) && reverse_workspace.hasCost(state) &&
+            workspace.cost(state) + reverse_workspace.cost(state) < best_cost)
+        {
+            best_cost = workspace.cost(state) + reverse_workspace.cost(state);
+            meeting_state = state;
+        }
+    };
+    // 和單向一樣，展開太多 state 就放棄
+    size_t count = 0;
+    while (!open_list.empty() && !reverse_open_list.empty())
+    {
+        if (best_cost <= open_list.topPriority().f + reverse_open_list.topPriority().f)
+        {
+            break;
+        }
+        count++;
+        if (count > max_expansions)
+        {
+            return {};
+        }
+        // expand the smaller frontier
+        if (open_list.size() <= reverse_open_list.size())
+        {
+            const int32_t current_state = open_list.pop();
+            workspace.close(current_state);
+            const int current_direction = current_state & 7;
+            const Point current = cellPoint(current_state >> 3);
+            if (current == goal)
+            {
+                continue;
+            }
+            const double current_cost = workspace.cost(current_state);
+            const bool any_direction = free_start && current_state == start_state;
+            for (int turn = 0; turn < (any_direction ? 8 : 3); ++turn)
+            {
+                const int direction = any_direction ? turn : (current_direction + (turn == 2 ? 7 : turn)) & 7;
+                const Point &d = direction_table[direction];
+                Point neighbor(current.x + d.x, current.y + d.y);
+                if (!bounds.contains(neighbor))
                 {
-                    new_cost += bend_cost;
+                    hit_window_edge = true;
+                    continue;
                 }
-
-                if (cost_so_far.find(neighbor) == cost_so_far.end() || new_cost < cost_so_far[neighbor])
+                if (isObstacle(neighbor))
                 {
-                    cost_so_far[neighbor] = new_cost;
-                    double priority = new_cost + heuristic(neighbor, goal);
-
-                    open_list.emplace(neighbor, new_cost, priority, current.point);
+                    continue;
+                }
+                if (d.x != 0 && d.y != 0 && isObstacle(current.x, neighbor.y) && isObstacle(neighbor.x, current.y))
+                {
+                    continue;
+                }
+                const int32_t neighbor_state = stateIndex(cellIndex(neighbor), direction);
+                if (workspace.isClosed(neighbor_state))
+                {
+                    continue;
+                }
+                double new_cost = current_cost + ((d.x != 0 && d.y != 0) ? costs.diagonal : costs.straight) +
+                                  costs.cell(cost(neighbor));
+                if (!any_direction && direction != current_direction)
+                {
+                    new_cost += costs.bend;
+                }
+                if (!workspace.hasCost(neighbor_state) || new_cost < workspace.cost(neighbor_state))
+                {
+                    workspace.relax(neighbor_state, new_cost, current_state);
+                    open_list.pushOrDecrease(neighbor_state,
+                                             SearchKey{new_cost + potential(neighbor), new_cost});
+                    meet(neighbor_state);
                 }
             }
         }
+        else
+        {
+            const int32_t current_state = reverse_open_list.pop();
+            reverse_workspace.close(current_state);
+            const int current_direction = current_state & 7;
+            const Point current = cellPoint(current_state >> 3);
+            if (current_state == start_state)
+            {
+                continue;
+            }
+            // every predecessor enters current from the same cell
+            const Point &d = direction_table[current_direction];
+            Point previous(current.x - d.x, current.y - d.y);
+            if (!bounds.contains(previous))
+            {
+                hit_window_edge = true;
+                continue;
+            }
+            if (isObstacle(previous))
+            {
+                continue;
+            }
+            if (d.x != 0 && d.y != 0 && isObstacle(previous.x, current.y) && isObstacle(current.x, previous.y))
+            {
+                continue;
+            }
+            const double edge_cost =
+                ((d.x != 0 && d.y != 0) ? costs.diagonal : costs.straight) + costs.cell(cost(current));
+            const double current_cost = reverse_workspace.cost(current_state);
+            const bool from_free_start = free_start && previous == start;
+            for (int turn = 0; turn < (from_free_start ? 1 : 3); ++turn)
+            {
+                const int direction =
+                    from_free_start ? start_direction : (current_direction + (turn == 2 ? 7 : turn)) & 7;
+                const int32_t previous_state = stateIndex(cellIndex(previous), direction);
+                if (reverse_workspace.isClosed(previous_state))
+                {
+                    continue;
+                }
+                double new_cost = current_cost + edge_cost;
+                if (!from_free_start && direction != current_direction)
+                {
+                    new_cost += costs.bend;
+                }
+                if (!reverse_workspace.hasCost(previous_state) || new_cost < reverse_workspace.cost(previous_state))
+                {
+                    reverse_workspace.relax(previous_state, new_cost, current_state);
+                    reverse_open_list.pushOrDecrease(previous_state,
+                                                     SearchKey{new_cost - potential(previous), new_cost});
+                    meet(previous_state);
+                }
+            }
+        }
+    }
+    if (meeting_state == -1)
+    {
+        return {};
     }
 
-    return {};
+    std::vector<Point> path;
+    for (int32_t temp = meeting_state; temp != -1; temp = workspace.parent(temp))
+    {
+        path.push_back(cellPoint(temp >> 3));
+    }
+    std::reverse(path.begin(), path.end());
+    for (int32_t temp = reverse_workspace.parent(meeting_state); temp != -1; temp = reverse_workspace.parent(temp))
+    {
+        path.push_back(cellPoint(temp >> 3));
+    }
+    return path;
+}
+
+namespace
+{
+// One LPA* pass over the tree of a net. The virtual state GOAL is entered at no cost from every incoming direction at
+// the goal cell, so the tree does not care which direction the route arrives with.
+class LpaSearch
+{
+public:
+    static constexpr int32_t GOAL = -2;
+    Grid &grid;
+    IncrementalTree &tree;
+    const StepCosts costs;
+    const int32_t start_state;
+
+    LpaSearch(Grid &_grid, IncrementalTree &_tree)
+        : grid(_grid)
+        , tree(_tree)
+        , costs(_grid.stepCosts())
+        , start_state(_grid.stateIndex(_grid.cellIndex(_tree.start), _tree.start_direction))
+    {
+    }
+    IncrementalTree::Values get(int32_t state) const
+    {
+        auto it = tree.values.find(state);
+        return it == tree.values.end() ? IncrementalTree::Values{} : it->second;
+    }
+    double heuristic(int32_t state) const
+    {
+        return state == GOAL ? 0 : costs.heuristic(grid.cellPoint(state >> 3), tree.goal);
+    }
+    void push(int32_t state, const IncrementalTree::Values &values)
+    {
+        const double k2 = std::min(values.g, values.rhs);
+        tree.open.push_back(IncrementalTree::Entry{k2 + heuristic(state), k2, state});
+        std::push_heap(tree.open.begin(), tree.open.end());
+    }
+    // The move into cell n in direction d, the same checks as a_star_search
+    bool canEnter(const Point &n, int direction) const
+    {
+        const Point &d = direction_table[direction];
+        if (!tree.bounds.contains(n) || grid.isObstacle(n))
+        {
+            return false;
+        }
+        return d.x == 0 || d.y == 0 || !(grid.isObstacle(n.x - d.x, n.y) && grid.isObstacle(n.x, n.y - d.y));
+    }
+    double enterCost(const Point &n, int direction) const
+    {
+        const Point &d = direction_table[direction];
+        return ((d.x != 0 && d.y != 0) ? costs.diagonal : costs.straight) + costs.cell(grid.cost(n));
+    }
+    // f(successor, edge cost) for every move out of state
+    template <typename F>
+    void forEachSuccessor(int32_t state, F &&f)
+    {
+        if (state == GOAL)
+        {
+            return;
+        }
+        const Point current = grid.cellPoint(state >> 3);
+        const int current_direction = state & 7;
+        if (current == tree.goal)
+        {
+            f(GOAL, 0.0);
+        }
+        const bool any_direction = tree.free_start && state == start_state;
+        for (int turn = 0; turn < (any_direction ? 8 : 3); ++turn)
+        {
+            const int direction = any_direction ? turn : (current_direction + (turn == 2 ? 7 : turn)) & 7;
+            const Point neighbor = current + direction_table[direction];
+            if (!tree.bounds.contains(neighbor))
+            {
+                grid.hit_window_edge = true;
+                continue;
+            }
+            if (!canEnter(neighbor, direction))
+            {
+                continue;
+            }
+            double cost = enterCost(neighbor, direction);
+            if (!any_direction && direction != current_direction)
+            {
+                cost += costs.bend;
+            }
+            f(grid.stateIndex(grid.cellIndex(neighbor), direction), cost);
+        }
+    }
+    // f(predecessor, edge cost) for every move into state
+    template <typename F>
+    void forEachPredecessor(int32_t state, F &&f) const
+    {
+        if (state == GOAL)
+        {
+            for (int direction = 0; direction < 8; ++direction)
+            {
+                f(grid.stateIndex(grid.cellIndex(tree.goal), direction), 0.0);
+            }
+            return;
+        }
+        const Point n = grid.cellPoint(state >> 3);
+        const int direction = state & 7;
+        const Point &d = direction_table[direction];
+        const Point previous(n.x - d.x, n.y - d.y);
+        if (!tree.bounds.contains(previous) || !canEnter(n, direction))
+        {
+            return;
+        }
+        const double cost = enterCost(n, direction);
+        if (tree.free_start && previous == tree.start)
+        {
+            f(start_state, cost);
+        }
+        for (int turn : {0, 1, 7})
+        {
+            const int32_t previous_state = grid.stateIndex(grid.cellIndex(previous), (direction + 8 - turn) & 7);
+            if (tree.free_start && previous_state == start_state)
+            {
+                continue;
+            }
+            f(previous_state, turn == 0 ? cost : cost + costs.bend);
+        }
+    }
+    void updateVertex(int32_t state)
+    {
+        if (state == start_state)
+        {
+            return;
+        }
+        double rhs = std::numeric_limits<double>::infinity();
+        forEachPredecessor(state, [&](int32_t previous, double cost) { rhs = std::min(rhs, get(previous).g + cost); });
+        auto it = tree.values.find(state);
+        if (it == tree.values.end())
+        {
+            if (rhs == std::numeric_limits<double>::infinity())
+            {
+                return;
+            }
+            it = tree.values.emplace(state, IncrementalTree::Values{}).first;
+        }
+        it->second.rhs = rhs;
+        if (it->second.g != it->second.rhs)
+        {
+            push(state, it->second);
+        }
+    }
+    // Expand inconsistent states until the goal is consistent and nothing in the open list can improve it, false if
+    // the expansion budget ran out
+    bool computeShortestPath(size_t max_expansions)
+    {
+        size_t count = 0;
+        while (!tree.open.empty())
+        {
+            const IncrementalTree::Entry top = tree.open.front();
+            const IncrementalTree::Values values = get(top.state);
+            const double k2 = std::min(values.g, values.rhs);
+            std::pop_heap(tree.open.begin(), tree.open.end());
+            tree.open.pop_back();
+            if (values.g == values.rhs || top.k2 != k2 || top.k1 != k2 + heuristic(top.state))
+            {
+                continue; // stale entry
+            }
+            const IncrementalTree::Values goal = get(GOAL);
+            const double goal_key = std::min(goal.g, goal.rhs);
+            // ties are expanded too, a goal cell state reaches the goal at its own key
+            if (goal.g == goal.rhs && top.k1 > goal_key)
+            {
+                tree.open.push_back(top); // still inconsistent, keep it for the next reroute
+                std::push_heap(tree.open.begin(), tree.open.end());
+                return true;
+            }
+            if (++count > max_expansions)
+            {
+                return false;
+            }
+            auto &current = tree.values[top.state];
+            if (current.g > current.rhs)
+            {
+                current.g = current.rhs;
+                const double g = current.g;
+                forEachSuccessor(top.state,
+                                 [&](int32_t next, double cost)
+                                 {
+                                     if (next == start_state)
+                                     {
+                                         return;
+                                     }
+                                     auto &v = tree.values[next];
+                                     if (g + cost < v.rhs)
+                                     {
+                                         v.rhs = g + cost;
+                                         push(next, v);
+                                     }
+                                 });
+            }
+            else
+            {
+                current.g = std::numeric_limits<double>::infinity();
+                updateVertex(top.state);
+                forEachSuccessor(top.state, [&](int32_t next, double) { updateVertex(next); });
+            }
+        }
+        return true;
+    }
+    // Follow the cheapest predecessors back from the goal
+    std::vector<Point> extractPath() const
+    {
+        std::vector<Point> path;
+        int32_t state = GOAL;
+        for (size_t steps = 0; state != start_state; ++steps)
+        {
+            int32_t best = -1;
+            double best_cost = std::numeric_limits<double>::infinity();
+            forEachPredecessor(state,
+                               [&](int32_t previous, double cost)
+                               {
+                                   if (get(previous).g + cost < best_cost)
+                                   {
+                                       best_cost = get(previous).g + cost;
+                                       best = previous;
+                                   }
+                               });
+            if (best == -1 || steps > tree.values.size())
+            {
+                return {};
+            }
+            state = best;
+            path.push_back(grid.cellPoint(state >> 3));
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+};
+} // namespace
+
+std::vector<Point> Grid::incremental_search(const int net_id,
+                                            const Coordinate &start,
+                                            const Coordinate &goal,
+                                            const Point &parent_direction,
+                                            const std::optional<Window> &corridor,
+                                            const Region *region)
+{
+    Point start_point = toPoint(start);
+    Point goal_point = toPoint(goal);
+    return incremental_search(net_id, start_point, goal_point, Point(start_point + parent_direction), corridor, region);
+}
+
+// A net keeps its tree while its start, goal, direction and bounds stay the same. Before the next search only the
+// states entering a cell that changed since then are updated, and LPA* repairs the part of the tree they affect.
+std::vector<Point> Grid::incremental_search(const int net_id,
+                                            Point start,
+                                            Point goal,
+                                            const Point &parent,
+                                            const std::optional<Window> &corridor,
+                                            const Region *region)
+{
+    if (!incremental)
+    {
+        return a_star_search(start, goal, parent, corridor, region);
+    }
+    hit_window_edge = false;
+    const Window bounds = corridor ? window().intersect(*corridor) : window();
+    if (!bounds.contains(start) || !bounds.contains(goal))
+    {
+        hit_window_edge = true;
+        return {};
+    }
+    // mark start and goal point grid as 0
+    clearObstacle(start);
+    clearObstacle(goal);
+    if (start == goal)
+    {
+        return {start};
+    }
+    const bool free_start = parent == Point(-1, -1);
+    int start_direction = directionIndex(Point(start.x - parent.x, start.y - parent.y));
+    if (start_direction < 0)
+    {
+        if (!free_start)
+        {
+            return {};
+        }
+        start_direction = 0;
+    }
+    const size_t max_expansions = static_cast<size_t>(rows) * cols * 4; // same budget as a_star_search
+
+    auto &tree = incremental_trees[net_id];
+    const bool reuse = !tree.values.empty() && tree.start == start && tree.goal == goal &&
+                       tree.start_direction == start_direction && tree.free_start == free_start &&
+                       tree.bounds.min_x == bounds.min_x && tree.bounds.min_y == bounds.min_y &&
+                       tree.bounds.max_x == bounds.max_x && tree.bounds.max_y == bounds.max_y &&
+                       tree.integer_cost == integer_cost;
+    if (!reuse)
+    {
+        tree = IncrementalTree{};
+        tree.start = start;
+        tree.goal = goal;
+        tree.start_direction = start_direction;
+        tree.free_start = free_start;
+        tree.bounds = bounds;
+        tree.integer_cost = integer_cost;
+    }
+    tree.last_used = ++cache_clock;
+    LpaSearch search(*this, tree);
+    if (reuse)
+    {
+        for (size_t i = tree.log_position; i < change_log.size(); ++i)
+        {
+            // a state the tree never reached only gets an entry if one of its predecessors is reached now
+            for (int32_t state = change_log[i] * 8; state < change_log[i] * 8 + 8; ++state)
+            {
+                search.updateVertex(state);
+            }
+        }
+    }
+    else
+    {
+        tree.values[search.start_state].rhs = 0;
+        search.push(search.start_state, tree.values[search.start_state]);
+    }
+    tree.log_position = change_log.size();
+    std::vector<Point> path;
+    if (search.computeShortestPath(max_expansions))
+    {
+        path = search.extractPath();
+    }
+    if (path.empty())
+    {
+        incremental_trees.erase(net_id);
+        // a repaired tree may not have looked at the window edge again, search once more from scratch for the flag
+        return reuse ? incremental_search(net_id, start, goal, parent, corridor) : path;
+    }
+
+    // keep the trees inside the memory budget, the least recently used go first
+    size_t usage = 0;
+    for (const auto &t : incremental_trees)
+    {
+        usage += t.second.memoryUsage();
+    }
+    while (usage > incremental_budget && !incremental_trees.empty())
+    {
+        auto oldest = incremental_trees.begin();
+        for (auto it = incremental_trees.begin(); it != incremental_trees.end(); ++it)
+        {
+            if (it->second.last_used < oldest->second.last_used)
+            {
+                oldest = it;
+            }
+        }
+        usage -= oldest->second.memoryUsage();
+        incremental_trees.erase(oldest);
+    }
+    // drop the part of the change log every tree has already seen
+    size_t seen = change_log.size();
+    for (const auto &t : incremental_trees)
+    {
+        seen = std::min(seen, t.second.log_position);
+    }
+    if (seen > change_log.size() / 2)
+    {
+        change_log.erase(change_log.begin(), change_log.begin() + seen);
+        for (auto &t : incremental_trees)
+        {
+            t.second.log_position -= seen;
+        }
+    }
+    return path;
 }
 
 std::vector<Segment> Grid::points2segments(const std::vector<Point> &points, const int &net_id, const int &layer)
@@ -189,7 +942,28 @@ std::vector<Segment> Grid::points2segments(const std::vector<Point> &points, con
     }
     return segments;
 }
-// Convert segments to points, need to follow the grid_width
+
+std::vector<Segment> Grid::runs2segments(const RunLengthPath &path, const int &net_id, const int &layer)
+{
+    std::vector<Segment> segments;
+    Point p = path.start;
+    for (const auto &run : path.runs)
+    {
+        const Point &d = direction_table[run.first];
+        const Point q(p.x + d.x * static_cast<int>(run.second), p.y + d.y * static_cast<int>(run.second));
+        Coordinate start(p.x * grid_width + bottom_left.x() + grid_width / 2,
+                         p.y * grid_width + bottom_left.y() + grid_width / 2,
+                         layer);
+        Coordinate end(q.x * grid_width + bottom_left.x() + grid_width / 2,
+                       q.y * grid_width + bottom_left.y() + grid_width / 2,
+                       layer);
+        segments.emplace_back(start, end, net_id);
+        p = q;
+    }
+    return segments;
+}
+
+// Convert segments to points, need to follow the grid_width, the part outside the grid window is skipped
 std::vector<Point> Grid::segments2points(const std::vector<Segment> &segments)
 {
     std::vector<Point> points;
@@ -201,44 +975,44 @@ std::vector<Point> Grid::segments2points(const std::vector<Segment> &segments)
         double slope = s.slope();
         if (slope == std::numeric_limits<double>::infinity())
         {
-            int start_y = (s.start().y() - bottom_left.y()) / grid_width;
-            int end_y = (s.end().y() - bottom_left.y()) / grid_width;
+            int start_y = toCellY(s.start().y());
+            int end_y = toCellY(s.end().y());
             if (start_y > end_y)
             {
                 std::swap(start_y, end_y);
             }
-            for (int y = start_y; y <= end_y; y++)
+            for (int y = std::max(start_y, 0); y <= std::min(end_y, cols - 1); y++)
             {
-                points.emplace_back((s.start().x() - bottom_left.x()) / grid_width, y);
+                points.emplace_back(toCellX(s.start().x()), y);
             }
         }
         else if (slope == 0.0)
         {
-            int start_x = (s.start().x() - bottom_left.x()) / grid_width;
-            int end_x = (s.end().x() - bottom_left.x()) / grid_width;
+            int start_x = toCellX(s.start().x());
+            int end_x = toCellX(s.end().x());
             if (start_x > end_x)
             {
                 std::swap(start_x, end_x);
             }
-            for (int x = start_x; x <= end_x; x++)
+            for (int x = std::max(start_x, 0); x <= std::min(end_x, rows - 1); x++)
             {
-                points.emplace_back(x, (s.start().y() - bottom_left.y()) / grid_width);
+                points.emplace_back(x, toCellY(s.start().y()));
             }
         }
         else
         {
-            int start_x = (s.start().x() - bottom_left.x()) / grid_width;
-            int end_x = (s.end().x() - bottom_left.x()) / grid_width;
-            int start_y = (s.start().y() - bottom_left.y()) / grid_width;
-            int end_y = (s.end().y() - bottom_left.y()) / grid_width;
+            int start_x = toCellX(s.start().x());
+            int end_x = toCellX(s.end().x());
+            int start_y = toCellY(s.start().y());
+            int end_y = toCellY(s.end().y());
             if (start_x > end_x)
             {
                 std::swap(start_x, end_x);
                 std::swap(start_y, end_y);
             }
-            for (int x = start_x; x <= end_x; x++)
+            for (int x = std::max(start_x, 0); x <= std::min(end_x, rows - 1); x++)
             {
-                int y = slope * (x - start_x) + start_y;
+                int y = std::floor(slope * (x - start_x) + start_y);
                 points.emplace_back(x, y);
             }
         }
@@ -247,7 +1021,41 @@ std::vector<Point> Grid::segments2points(const std::vector<Segment> &segments)
     return points;
 }
 
-void Grid::addCost(const Point &point, double cost) { cost_grid[point.x][point.y] += cost; }
+// Take over obstacles and costs of an overlapping grid with the same grid_width and alignment, e.g. when a window
+// grows. Inside the overlap the obstacles of other replace the ones of this grid, cells of other outside this grid are
+// dropped
+void Grid::copyFrom(const Grid &other)
+{
+    for (int x = 0; x < other.rows; ++x)
+    {
+        for (int y = 0; y < other.cols; ++y)
+        {
+            Point p = fromGrid(other, Point(x, y));
+            if (!inBounds(p))
+            {
+                continue;
+            }
+            if (other.isObstacle(x, y))
+            {
+                obstacle_plane.set(p.x, p.y);
+            }
+            else
+            {
+                obstacle_plane.reset(p.x, p.y);
+            }
+            if (other.cost(x, y) != 0)
+            {
+                cost_plane.add(p.x, p.y, other.cost(x, y));
+            }
+        }
+    }
+}
+
+void Grid::addCost(const Point &point, double cost)
+{
+    logChange(point.x, point.y);
+    cost_plane.add(point.x, point.y, cost);
+}
 
 void Grid::addPathCost(const std::vector<Point> &path)
 {
@@ -333,8 +1141,102 @@ void Grid::ripUpPath(const std::vector<Point> &path)
 {
     for (const auto &p : path)
     {
-        cost_grid[p.x][p.y] -= path_cost;
+        addCost(p, -path_cost);
+    }
+}
+
+int32_t Grid::diagonalIndex(const Point &from, const Point &to) const
+{
+    int orientation = (to.x - from.x) * (to.y - from.y) > 0 ? 0 : 1;
+    return cellIndex(Point(std::min(from.x, to.x), std::min(from.y, to.y))) * 2 + orientation;
+}
+
+void Grid::addPathOwner(const std::vector<Point> &path, const int net_id)
+{
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        if (!inBounds(path[i]))
+        {
+            continue;
+        }
+        cell_owners.add(cellIndex(path[i]), net_id);
+        if (i > 0 && path[i].x != path[i - 1].x && path[i].y != path[i - 1].y && inBounds(path[i - 1]))
+        {
+            diagonal_owners.add(diagonalIndex(path[i - 1], path[i]), net_id);
+        }
+    }
+}
+
+void Grid::removePathOwner(const std::vector<Point> &path, const int net_id)
+{
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        if (!inBounds(path[i]))
+        {
+            continue;
+        }
+        cell_owners.remove(cellIndex(path[i]), net_id);
+        if (i > 0 && path[i].x != path[i - 1].x && path[i].y != path[i - 1].y && inBounds(path[i - 1]))
+        {
+            diagonal_owners.remove(diagonalIndex(path[i - 1], path[i]), net_id);
+        }
+    }
+}
+
+std::vector<Conflict> Grid::conflicts(const std::vector<Point> &path, const int net_id) const
+{
+    std::vector<Conflict> result;
+    std::unordered_map<int, size_t> position; // net_id -> index in result
+    auto conflictOf = [&](int other) -> Conflict &
+    {
+        auto it = position.emplace(other, result.size()).first;
+        if (it->second == result.size())
+        {
+            result.push_back(Conflict{other, {}, false});
+        }
+        return result[it->second];
+    };
+    std::unordered_set<int32_t> cells;
+    for (const auto &p : path)
+    {
+        if (inBounds(p))
+        {
+            cells.insert(cellIndex(p));
+        }
+    }
+    for (const auto &p : path)
+    {
+        if (!inBounds(p))
+        {
+            continue;
+        }
+        cell_owners.forEach(cellIndex(p),
+                            [&](int other)
+                            {
+                                if (other != net_id)
+                                {
+                                    conflictOf(other).overlap.push_back(p);
+                                }
+                            });
+        // p and q are opposite corners of a 2x2 block, a diagonal step through the other two corners crosses the path
+        for (int dy : {1, -1})
+        {
+            Point q(p.x + 1, p.y + dy);
+            if (!inBounds(q) || !cells.count(cellIndex(q)))
+            {
+                continue;
+            }
+            diagonal_owners.forEach(diagonalIndex(Point(q.x, p.y), Point(p.x, q.y)),
+                                    [&](int other)
+                                    {
+                                        if (other != net_id)
+                                        {
+                                            conflictOf(other).crossing = true;
+                                        }
+                                    });
+        }
     }
+    return result;
 }
 
 void Grid::addObstacle(const Via &obstacle) { addObstacle(obstacle.coordinate()); }
@@ -343,15 +1245,16 @@ void Grid::addObstacle(const Obstacle &obstacle)
 {
     // mark the whole area of the obstacle as 1
     // obstacle's cooridnate is the bottom left and top right, and the grid_width is the unit
-    for (int x = (obstacle.bottom_left().x() - bottom_left.x()) / grid_width;
-         x <= (obstacle.top_right().x() - bottom_left.x()) / grid_width;
+    // only the part inside the grid window is rasterized
+    for (int x = std::max(toCellX(obstacle.bottom_left().x()), 0);
+         x <= std::min(toCellX(obstacle.top_right().x()), rows - 1);
          x++)
     {
-        for (int y = (obstacle.bottom_left().y() - bottom_left.y()) / grid_width;
-             y <= (obstacle.top_right().y() - bottom_left.y()) / grid_width;
+        for (int y = std::max(toCellY(obstacle.bottom_left().y()), 0);
+             y <= std::min(toCellY(obstacle.top_right().y()), cols - 1);
              y++)
         {
-            grid[x][y] = 1;
+            setObstacle(x, y);
         }
     }
 }
@@ -361,7 +1264,7 @@ void Grid::addObstacle(const Segment &obstacle)
     std::vector<Point> points = segments2points({obstacle});
     for (const auto &p : points)
     {
-        grid[p.x][p.y] = 1;
+        setObstacle(p.x, p.y);
     }
 }
 
@@ -375,15 +1278,219 @@ void Grid::addObstacle(std::vector<Segment> &obstacles)
 
 void Grid::addObstacle(const Coordinate &obstacle)
 {
-    grid[(obstacle.x() - bottom_left.x()) / grid_width][(obstacle.y() - bottom_left.y()) / grid_width] = 1;
+    Point p = toPoint(obstacle);
+    setObstacle(p.x, p.y);
 }
 
-void Grid::addObstacle(const Point &obstacle) { grid[obstacle.x][obstacle.y] = 1; }
+void Grid::addObstacle(const Point &obstacle) { setObstacle(obstacle.x, obstacle.y); }
 
 void Grid::addObstacle(const std::vector<Point> &obstacle)
 {
     for (const auto &o : obstacle)
     {
-        grid[o.x][o.y] = 1;
+        setObstacle(o.x, o.y);
     }
-}
\ No newline at end of file
+}
+CoarseGrid::CoarseGrid(const Grid &grid, const std::pair<double, double> &left_bottom, double width, double height)
+{
+    // global coarse index of the center of every fine row / column
+    auto coarse = [](double center, double left, double size)
+    { return static_cast<int>(std::floor((center - left) / size)); };
+    origin = Point(coarse(grid.bottom_left.x() + 0.5 * grid.grid_width, left_bottom.first, width),
+                   coarse(grid.bottom_left.y() + 0.5 * grid.grid_width, left_bottom.second, height));
+    lookup.coarse_x.resize(grid.rows);
+    for (int x = 0; x < grid.rows; ++x)
+    {
+        lookup.coarse_x[x] =
+            coarse(grid.bottom_left.x() + (x + 0.5) * grid.grid_width, left_bottom.first, width) - origin.x;
+    }
+    lookup.coarse_y.resize(grid.cols);
+    for (int y = 0; y < grid.cols; ++y)
+    {
+        lookup.coarse_y[y] =
+            coarse(grid.bottom_left.y() + (y + 0.5) * grid.grid_width, left_bottom.second, height) - origin.y;
+    }
+    rows = grid.rows > 0 ? lookup.coarse_x.back() + 1 : 0;
+    cols = grid.cols > 0 ? lookup.coarse_y.back() + 1 : 0;
+    lookup.coarse_cols = cols;
+    capacity.assign(static_cast<size_t>(rows) * cols, 0);
+    usage.assign(capacity.size(), 0);
+    for (int x = 0; x < grid.rows; ++x)
+    {
+        for (int y = 0; y < grid.cols; ++y)
+        {
+            if (!grid.isObstacle(x, y))
+            {
+                capacity[lookup.coarse_x[x] * cols + lookup.coarse_y[y]] += 1;
+            }
+        }
+    }
+    const double tracks_per_cell = std::max(1.0, (width + height) / 2 / grid.grid_width);
+    for (auto &c : capacity)
+    {
+        c /= tracks_per_cell;
+    }
+}
+
+std::vector<Point> CoarseGrid::route(const Point &from, const Point &to) const
+{
+    const auto fine_rows = static_cast<int>(lookup.coarse_x.size());
+    const auto fine_cols = static_cast<int>(lookup.coarse_y.size());
+    if (from.x < 0 || from.x >= fine_rows || from.y < 0 || from.y >= fine_cols || to.x < 0 || to.x >= fine_rows ||
+        to.y < 0 || to.y >= fine_cols)
+    {
+        return {};
+    }
+    const Point start = cellOf(from);
+    const Point goal = cellOf(to);
+    const int goal_index = index(goal);
+    std::vector<double> cost(capacity.size(), std::numeric_limits<double>::infinity());
+    std::vector<int> parent(capacity.size(), -1);
+    using Entry = std::pair<double, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    cost[index(start)] = 0;
+    queue.emplace(heuristic(start, goal), index(start));
+    while (!queue.empty())
+    {
+        const auto [f, current] = queue.top();
+        queue.pop();
+        const Point c(origin.x + current / cols, origin.y + current % cols);
+        if (f > cost[current] + heuristic(c, goal))
+        {
+            continue;
+        }
+        if (current == goal_index)
+        {
+            std::vector<Point> path;
+            for (int i = current; i != -1; i = parent[i])
+            {
+                path.push_back(Point(origin.x + i / cols, origin.y + i % cols));
+            }
+            std::reverse(path.begin(), path.end());
+            return path;
+        }
+        for (const auto &d : direction_table)
+        {
+            const Point n = c + d;
+            if (!inBounds(n))
+            {
+                continue;
+            }
+            const int next = index(n);
+            // the escape points may sit in a cell without free fine cells around them
+            if (capacity[next] == 0 && next != goal_index)
+            {
+                continue;
+            }
+            const double step = (d.x != 0 && d.y != 0) ? sqrt(2) : 1;
+            double new_cost = cost[current] + step * (1 + usage[next] / std::max(capacity[next], 1.0));
+            if (usage[next] + 1 > capacity[next])
+            {
+                new_cost += overflow_cost * step;
+            }
+            if (new_cost < cost[next])
+            {
+                cost[next] = new_cost;
+                parent[next] = current;
+                queue.emplace(new_cost + heuristic(n, goal), next);
+            }
+        }
+    }
+    return {};
+}
+
+std::vector<Point> CoarseGrid::cellsOf(const std::vector<Point> &path) const
+{
+    std::vector<Point> cells;
+    for (const auto &p : path)
+    {
+        const Point cell = cellOf(p);
+        if (cells.empty() || !(cells.back() == cell))
+        {
+            cells.push_back(cell);
+        }
+    }
+    return cells;
+}
+
+void CoarseGrid::addUsage(const std::vector<Point> &cells, int delta)
+{
+    for (const auto &cell : cells)
+    {
+        if (inBounds(cell))
+        {
+            usage[index(cell)] += delta;
+        }
+    }
+}
+
+Region CoarseGrid::region(const std::vector<Point> &cells, int margin) const
+{
+    Region region = lookup;
+    region.allowed.assign(capacity.size(), 0);
+    for (const auto &cell : cells)
+    {
+        for (int i = std::max(cell.x - margin, origin.x); i <= std::min(cell.x + margin, origin.x + rows - 1); ++i)
+        {
+            for (int j = std::max(cell.y - margin, origin.y); j <= std::min(cell.y + margin, origin.y + cols - 1); ++j)
+            {
+                region.allowed[index(Point(i, j))] = 1;
+            }
+        }
+    }
+    return region;
+}
+
+RunLengthPath::RunLengthPath(const std::vector<Point> &points)
+    : num_points(points.size())
+{
+    if (points.empty())
+    {
+        return;
+    }
+    start = points.front();
+    for (size_t i = 1; i < points.size(); ++i)
+    {
+        const int direction = directionIndex(Point(points[i].x - points[i - 1].x, points[i].y - points[i - 1].y));
+        if (direction < 0)
+        {
+            throw std::runtime_error("RunLengthPath: points are not unit steps");
+        }
+        if (!runs.empty() && runs.back().first == direction)
+        {
+            ++runs.back().second;
+        }
+        else
+        {
+            runs.emplace_back(direction, 1);
+        }
+    }
+    runs.shrink_to_fit();
+}
+
+std::vector<Point> RunLengthPath::points() const
+{
+    std::vector<Point> points;
+    points.reserve(num_points);
+    forEachPoint([&](const Point &p) { points.push_back(p); });
+    return points;
+}
+
+void RunLengthPath::trim()
+{
+    if (num_points <= 2)
+    {
+        *this = RunLengthPath();
+        return;
+    }
+    start = start + direction_table[runs.front().first];
+    if (--runs.front().second == 0)
+    {
+        runs.erase(runs.begin());
+    }
+    if (--runs.back().second == 0)
+    {
+        runs.pop_back();
+    }
+    num_points -= 2;
+}
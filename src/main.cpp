@@ -61,10 +61,8 @@ int main(int argc, char const *argv[])
     gdt_writer.preprocess();
 #endif
 
-    utils::printlog("Escape Routing DDR2DDR...");
-    data_manager->DDR2DDR();
-    utils::printlog("Escape Routing CPU2DDR...");
-    data_manager->CPU2DDR();
+    utils::printlog("Escape Routing DDR2DDR and CPU2DDR...");
+    data_manager->escapeRouting();
     data_manager->postprocess_ER();
 #ifdef GDT
     gdt_writer.routing();
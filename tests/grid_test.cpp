@@ -0,0 +1,678 @@
+#include "flow_network.hpp"
+#include "grid.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+class GridTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // 100 x 100 cells, grid_width = 1
+        grid = std::make_shared<A_Star::Grid>(Coordinate(0, 0, 0), Coordinate(100, 100, 0), 1.0);
+    }
+
+    void TearDown() override
+    {
+        // Teardown code here, if needed.
+    }
+    std::shared_ptr<A_Star::Grid> grid;
+};
+
+// Cost of a route as the search charges it: step length, cell cost of every entered cell and bend cost per turn
+double routeCost(const A_Star::Grid &grid, const std::vector<A_Star::Point> &path)
+{
+    double total = 0;
+    for (size_t i = 1; i < path.size(); ++i)
+    {
+        bool diagonal = path[i].x != path[i - 1].x && path[i].y != path[i - 1].y;
+        total += (diagonal ? std::sqrt(2) : 1) + grid.cost(path[i]);
+        if (i > 1 && !(path[i].x - path[i - 1].x == path[i - 1].x - path[i - 2].x &&
+                       path[i].y - path[i - 1].y == path[i - 1].y - path[i - 2].y))
+        {
+            total += grid.bend_cost;
+        }
+    }
+    return total;
+}
+
+// Test the bit-packed obstacle plane across word boundaries
+TEST_F(GridTest, ObstaclePlaneSetAndReset)
+{
+    A_Star::ObstaclePlane plane(9, 13);
+    for (int x = 0; x < 9; ++x)
+    {
+        for (int y = 0; y < 13; ++y)
+        {
+            EXPECT_FALSE(plane.test(x, y));
+        }
+    }
+    plane.set(4, 12);
+    plane.set(5, 0);
+    EXPECT_TRUE(plane.test(4, 12));
+    EXPECT_TRUE(plane.test(5, 0));
+    EXPECT_FALSE(plane.test(4, 11));
+    EXPECT_FALSE(plane.test(5, 1));
+    plane.reset(4, 12);
+    EXPECT_FALSE(plane.test(4, 12));
+    EXPECT_TRUE(plane.test(5, 0));
+}
+
+// Test tiles of a large grid are only allocated where obstacles, costs or searches actually are
+TEST_F(GridTest, SparseTilesOnLargeGrid)
+{
+    A_Star::Grid large(Coordinate(0, 0, 0), Coordinate(4000, 3000, 0), 1.0);
+    for (const auto &p : {A_Star::Point(0, 0), A_Star::Point(63, 64), A_Star::Point(64, 63), A_Star::Point(3999, 2999)})
+    {
+        EXPECT_EQ(large.cellPoint(large.cellIndex(p)), p);
+    }
+    EXPECT_EQ(large.obstacle_plane.numAllocatedTiles(), 0u);
+    large.addObstacle(Obstacle(Coordinate(2000, 1000, 0), Coordinate(2010, 1010, 0), 0));
+    large.addCost(A_Star::Point(2005, 1020), 3.0);
+    EXPECT_TRUE(large.isObstacle(2005, 1005));
+    EXPECT_FALSE(large.isObstacle(10, 10));
+    EXPECT_DOUBLE_EQ(large.cost(2005, 1020), 3.0);
+    EXPECT_DOUBLE_EQ(large.cost(10, 10), 0.0);
+    EXPECT_EQ(large.obstacle_plane.numAllocatedTiles(), 1u);
+    EXPECT_EQ(large.cost_plane.numAllocatedTiles(), 1u);
+    EXPECT_LT(large.obstacle_plane.memoryUsage() + large.cost_plane.memoryUsage(), 200000u);
+
+    auto path = large.a_star_search(A_Star::Point(1990, 1005), A_Star::Point(2020, 1005), A_Star::Point(-1, -1));
+    ASSERT_FALSE(path.empty());
+    EXPECT_EQ(path.back(), A_Star::Point(2020, 1005));
+    for (const auto &p : path)
+    {
+        EXPECT_FALSE(large.isObstacle(p));
+    }
+    // the search only pages in the tiles around the obstacle, not the 12M x 8 states of the grid
+    EXPECT_LT(large.workspace.memoryUsage(), large.numStates() * sizeof(double) / 100);
+}
+
+// Test conflicts come from the owner maps and match the point-list overlap and crossing checks
+TEST_F(GridTest, OwnerMapConflicts)
+{
+    std::vector<A_Star::Point> horizontal = {{0, 5}, {1, 5}, {2, 5}, {3, 5}, {4, 5}};
+    std::vector<A_Star::Point> diagonal = {{6, 0}, {7, 1}, {8, 2}};
+    std::vector<A_Star::Point> shared = {{2, 5}, {2, 6}};
+    grid->addPathOwner(horizontal, 1);
+    grid->addPathOwner(diagonal, 2);
+    grid->addPathOwner(shared, 3); // (2, 5) has two owners now
+
+    std::vector<A_Star::Point> path = {{2, 3}, {2, 4}, {2, 5}, {3, 6}, {4, 6}, {7, 0}, {6, 1}};
+    auto conflicts = grid->conflicts(path, 4);
+    ASSERT_EQ(conflicts.size(), 3u);
+    EXPECT_EQ(conflicts[0].net_id, 1);
+    EXPECT_EQ(conflicts[0].overlap, std::vector<A_Star::Point>({{2, 5}}));
+    EXPECT_EQ(conflicts[1].net_id, 3);
+    EXPECT_EQ(conflicts[2].net_id, 2);
+    EXPECT_TRUE(conflicts[2].overlap.empty());
+    EXPECT_TRUE(conflicts[2].crossing);
+    EXPECT_EQ(grid->isOverlap(horizontal, path), !conflicts[0].overlap.empty());
+    EXPECT_EQ(grid->isCrossing(diagonal, path), conflicts[2].crossing);
+    EXPECT_TRUE(grid->conflicts(path, 1).size() == 2u); // a net never conflicts with itself
+
+    grid->removePathOwner(shared, 3);
+    grid->removePathOwner(diagonal, 2);
+    conflicts = grid->conflicts(path, 4);
+    ASSERT_EQ(conflicts.size(), 1u);
+    EXPECT_EQ(conflicts[0].net_id, 1);
+}
+
+// Test the reroute queue keeps FIFO order or pops by score, and never queues a net twice
+TEST_F(GridTest, RerouteQueueOrder)
+{
+    auto candidate = [](int net_id) { return RouteCandidate(Coordinate(0, 0, 0), Coordinate(1, 1, 0), net_id, 0); };
+    RerouteQueue fifo(8);
+    EXPECT_TRUE(fifo.push(candidate(5)));
+    EXPECT_TRUE(fifo.push(candidate(2), 10));
+    EXPECT_FALSE(fifo.push(candidate(5), 20));
+    EXPECT_TRUE(fifo.contains(2));
+    EXPECT_EQ(fifo.size(), 2u);
+    EXPECT_EQ(fifo.pop().net_id, 5);
+    EXPECT_FALSE(fifo.contains(5));
+    EXPECT_EQ(fifo.pop().net_id, 2);
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_THROW(fifo.push(candidate(8)), std::runtime_error);
+
+    RerouteQueue by_score(8, ReroutePriority::MOST_CONFLICTS);
+    by_score.push(candidate(1), 1);
+    by_score.push(candidate(3), 2);
+    by_score.push(candidate(4), 1);
+    EXPECT_FALSE(by_score.push(candidate(4), 5)); // already waiting, only the score is raised
+    EXPECT_FALSE(by_score.push(candidate(3), 0)); // a lower score is ignored
+    EXPECT_EQ(by_score.pop().net_id, 4);
+    EXPECT_EQ(by_score.pop().net_id, 3);
+    EXPECT_TRUE(by_score.push(candidate(4), 1)); // ties keep queue order
+    EXPECT_EQ(by_score.pop().net_id, 1);
+    EXPECT_EQ(by_score.pop().net_id, 4);
+    EXPECT_TRUE(by_score.empty());
+}
+
+// Test the cost plane accumulates path, history and rip-up costs
+TEST_F(GridTest, CostPlaneAddAndRipUp)
+{
+    std::vector<A_Star::Point> path = {{1, 1}, {2, 2}, {3, 2}};
+    grid->addPathCost(path);
+    grid->addHistoryCost(path);
+    EXPECT_DOUBLE_EQ(grid->cost(2, 2), grid->path_cost + grid->history_cost);
+    grid->ripUpPath(path);
+    EXPECT_DOUBLE_EQ(grid->cost(2, 2), grid->history_cost);
+    EXPECT_DOUBLE_EQ(grid->cost(0, 0), 0.0);
+}
+
+// Test obstacles outside the grid are ignored instead of written out of range
+TEST_F(GridTest, ObstacleOutOfBounds)
+{
+    grid->addObstacle(Obstacle(Coordinate(98, 98, 0), Coordinate(102, 102, 0), 0));
+    EXPECT_TRUE(grid->isObstacle(99, 99));
+    EXPECT_TRUE(grid->isObstacle(98, 98));
+    EXPECT_FALSE(grid->isObstacle(97, 98));
+    grid->addObstacle(A_Star::Point(-1, 3));
+    EXPECT_FALSE(grid->isObstacle(0, 3));
+}
+
+// Test the search routes around a wall
+TEST_F(GridTest, SearchAroundWall)
+{
+    for (int y = 0; y < 30; ++y)
+    {
+        grid->addObstacle(A_Star::Point(20, y));
+    }
+    auto path = grid->a_star_search(A_Star::Point(1, 1), A_Star::Point(38, 1), A_Star::Point(0, 1));
+    ASSERT_FALSE(path.empty());
+    EXPECT_TRUE(path.front() == A_Star::Point(1, 1));
+    EXPECT_TRUE(path.back() == A_Star::Point(38, 1));
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        EXPECT_FALSE(grid->isObstacle(path[i]));
+        if (i > 0)
+        {
+            EXPECT_LE(std::abs(path[i].x - path[i - 1].x), 1);
+            EXPECT_LE(std::abs(path[i].y - path[i - 1].y), 1);
+        }
+    }
+}
+
+// Test consecutive searches on one grid do not see each other's stale state
+TEST_F(GridTest, WorkspaceReuseAcrossSearches)
+{
+    auto first = grid->a_star_search(A_Star::Point(5, 5), A_Star::Point(30, 5), A_Star::Point(4, 5));
+    for (int y = 0; y < 40; ++y)
+    {
+        grid->addObstacle(A_Star::Point(15, y));
+    }
+    auto second = grid->a_star_search(A_Star::Point(5, 5), A_Star::Point(30, 5), A_Star::Point(4, 5));
+    auto third = grid->a_star_search(A_Star::Point(5, 5), A_Star::Point(30, 5), A_Star::Point(4, 5));
+    ASSERT_EQ(first.size(), 26u);
+    ASSERT_FALSE(second.empty());
+    EXPECT_GT(second.size(), first.size());
+    ASSERT_EQ(second.size(), third.size());
+    for (size_t i = 0; i < second.size(); ++i)
+    {
+        EXPECT_TRUE(second[i] == third[i]);
+        EXPECT_FALSE(grid->isObstacle(second[i]));
+    }
+}
+
+// Test the indexed heap pops in priority order and applies decrease-key in place
+TEST_F(GridTest, IndexedHeapDecreaseKey)
+{
+    IndexedHeap<double, 4> heap(16);
+    for (int key = 0; key < 10; ++key)
+    {
+        heap.push(key, 100.0 - key);
+    }
+    EXPECT_EQ(heap.top(), 9);
+    heap.decrease(3, 1.0);
+    heap.decrease(4, 500.0); // not better, ignored
+    heap.pushOrDecrease(5, 2.0);
+    heap.pushOrDecrease(12, 1.5);
+    EXPECT_EQ(heap.size(), 11u);
+    EXPECT_EQ(heap.pop(), 3);
+    EXPECT_EQ(heap.pop(), 12);
+    EXPECT_EQ(heap.pop(), 5);
+    EXPECT_FALSE(heap.contains(5));
+    EXPECT_DOUBLE_EQ(heap.priority(4), 96.0);
+    double last = -1.0;
+    while (!heap.empty())
+    {
+        double priority = heap.topPriority();
+        EXPECT_LE(last, priority);
+        last = priority;
+        heap.pop();
+    }
+    heap.reset(16);
+    EXPECT_FALSE(heap.contains(9));
+}
+
+// Test a free route keeps its incoming direction instead of paying bend cost
+TEST_F(GridTest, SearchKeepsIncomingDirection)
+{
+    auto path = grid->a_star_search(A_Star::Point(10, 10), A_Star::Point(60, 10), A_Star::Point(9, 10));
+    ASSERT_EQ(path.size(), 51u);
+    for (const auto &p : path)
+    {
+        EXPECT_EQ(p.y, 10);
+    }
+    // entering from the goal side only allows 45 degree turns, the route has to swing around
+    auto back = grid->a_star_search(A_Star::Point(10, 10), A_Star::Point(20, 10), A_Star::Point(11, 10));
+    ASSERT_FALSE(back.empty());
+    EXPECT_GT(back.size(), 11u);
+    for (size_t i = 1; i < back.size(); ++i)
+    {
+        EXPECT_LE(std::abs(back[i].x - back[i - 1].x), 1);
+        EXPECT_LE(std::abs(back[i].y - back[i - 1].y), 1);
+    }
+}
+
+// Test the radix heap pops monotone keys in order and rejects keys below the last pop
+TEST_F(GridTest, RadixHeapMonotonePop)
+{
+    RadixHeap<int> heap;
+    heap.push(40, 1);
+    heap.push(7, 2);
+    heap.push(1000000, 3);
+    heap.push(7, 4);
+    EXPECT_EQ(heap.topKey(), 7u);
+    int first = heap.pop();
+    int second = heap.pop();
+    EXPECT_TRUE((first == 2 && second == 4) || (first == 4 && second == 2));
+    heap.push(39, 5);
+    EXPECT_EQ(heap.pop(), 5);
+    EXPECT_THROW(heap.push(10, 6), std::runtime_error);
+    EXPECT_EQ(heap.pop(), 1);
+    EXPECT_EQ(heap.pop(), 3);
+    EXPECT_TRUE(heap.empty());
+}
+
+// Test the integer cost mode finds a route of the same cost as the double mode
+TEST_F(GridTest, IntegerCostSearch)
+{
+    for (int y = 0; y < 30; ++y)
+    {
+        grid->addObstacle(A_Star::Point(20, y));
+    }
+    std::vector<A_Star::Point> history = {{25, 31}, {25, 32}, {26, 33}};
+    grid->addHistoryCost(history);
+    auto double_path = grid->a_star_search(A_Star::Point(1, 1), A_Star::Point(38, 1), A_Star::Point(0, 1));
+    grid->integer_cost = true;
+    auto integer_path = grid->a_star_search(A_Star::Point(1, 1), A_Star::Point(38, 1), A_Star::Point(0, 1));
+    ASSERT_FALSE(integer_path.empty());
+    EXPECT_TRUE(integer_path.front() == A_Star::Point(1, 1));
+    EXPECT_TRUE(integer_path.back() == A_Star::Point(38, 1));
+    EXPECT_NEAR(routeCost(*grid, integer_path), routeCost(*grid, double_path), 0.01 * integer_path.size());
+}
+
+// Test jump search returns a connected, obstacle free route with every jumped cell filled in
+TEST_F(GridTest, JumpSearchRoute)
+{
+    for (int x = 40; x < 50; ++x)
+    {
+        grid->addObstacle(A_Star::Point(x, 50));
+    }
+    std::vector<A_Star::Point> history = {{70, 70}, {71, 71}};
+    grid->addHistoryCost(history);
+    auto exact = grid->a_star_search(A_Star::Point(45, 5), A_Star::Point(45, 95), A_Star::Point(45, 4));
+    grid->jump_search = true;
+    auto jumped = grid->a_star_search(A_Star::Point(45, 5), A_Star::Point(45, 95), A_Star::Point(45, 4));
+    ASSERT_FALSE(exact.empty());
+    ASSERT_FALSE(jumped.empty());
+    EXPECT_TRUE(jumped.front() == A_Star::Point(45, 5));
+    EXPECT_TRUE(jumped.back() == A_Star::Point(45, 95));
+    for (size_t i = 1; i < jumped.size(); ++i)
+    {
+        EXPECT_FALSE(grid->isObstacle(jumped[i]));
+        EXPECT_LE(std::abs(jumped[i].x - jumped[i - 1].x), 1);
+        EXPECT_LE(std::abs(jumped[i].y - jumped[i - 1].y), 1);
+        EXPECT_FALSE(jumped[i] == jumped[i - 1]);
+    }
+    // open board, the jumps reach the goal by the same straight run
+    auto open_jumped = grid->a_star_search(A_Star::Point(5, 80), A_Star::Point(90, 80), A_Star::Point(4, 80));
+    grid->jump_search = false;
+    auto open_exact = grid->a_star_search(A_Star::Point(5, 80), A_Star::Point(90, 80), A_Star::Point(4, 80));
+    EXPECT_EQ(open_exact.size(), open_jumped.size());
+}
+
+// Test the bidirectional search finds routes as cheap as the one-sided search and keeps the start direction
+TEST_F(GridTest, BidirectionalSearchCost)
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> cell(5, 94);
+    for (int i = 0; i < 400; ++i)
+    {
+        grid->addObstacle(A_Star::Point(cell(rng), cell(rng)));
+    }
+    for (int i = 0; i < 300; ++i)
+    {
+        grid->addHistoryCost({A_Star::Point(cell(rng), cell(rng))});
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        A_Star::Point start(cell(rng), cell(rng));
+        A_Star::Point goal(cell(rng), cell(rng));
+        A_Star::Point parent(start.x - 1, start.y + (i % 3) - 1);
+        grid->bidirectional = false;
+        auto one_sided = grid->a_star_search(start, goal, parent);
+        grid->bidirectional = true;
+        auto both_sides = grid->a_star_search(start, goal, parent);
+        ASSERT_EQ(one_sided.empty(), both_sides.empty());
+        if (both_sides.empty())
+        {
+            continue;
+        }
+        EXPECT_TRUE(both_sides.front() == start);
+        EXPECT_TRUE(both_sides.back() == goal);
+        if (both_sides.size() > 1)
+        {
+            // the first move may only turn 45 degrees away from the incoming direction
+            A_Star::Point first(both_sides[1].x - start.x, both_sides[1].y - start.y);
+            A_Star::Point incoming(start.x - parent.x, start.y - parent.y);
+            int turn = (A_Star::directionIndex(first) - A_Star::directionIndex(incoming) + 8) % 8;
+            EXPECT_TRUE(turn == 0 || turn == 1 || turn == 7);
+        }
+        std::vector<A_Star::Point> with_parent = both_sides, one_with_parent = one_sided;
+        with_parent.insert(with_parent.begin(), parent);
+        one_with_parent.insert(one_with_parent.begin(), parent);
+        EXPECT_NEAR(routeCost(*grid, with_parent), routeCost(*grid, one_with_parent), 1e-6);
+    }
+}
+
+// Test repaired LPA* trees find routes as cheap as a fresh A* search while costs keep changing
+TEST_F(GridTest, IncrementalSearchCost)
+{
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> cell(5, 94);
+    grid->incremental = true;
+    for (int i = 0; i < 400; ++i)
+    {
+        grid->addObstacle(A_Star::Point(cell(rng), cell(rng)));
+    }
+    std::vector<std::pair<A_Star::Point, A_Star::Point>> nets;
+    for (int i = 0; i < 4; ++i)
+    {
+        nets.emplace_back(A_Star::Point(cell(rng), cell(rng)), A_Star::Point(cell(rng), cell(rng)));
+    }
+    size_t routed = 0;
+    for (int round = 0; round < 6; ++round)
+    {
+        routed = 0;
+        for (size_t net = 0; net < nets.size(); ++net)
+        {
+            const auto &start = nets[net].first;
+            const auto &goal = nets[net].second;
+            A_Star::Point parent(start.x - 1, start.y + static_cast<int>(net % 3) - 1);
+            auto incremental = grid->incremental_search(net, start, goal, parent, std::nullopt);
+            auto fresh = grid->a_star_search(start, goal, parent);
+            ASSERT_EQ(incremental.empty(), fresh.empty());
+            if (fresh.empty())
+            {
+                continue;
+            }
+            ++routed;
+            EXPECT_TRUE(incremental.front() == start);
+            EXPECT_TRUE(incremental.back() == goal);
+            incremental.insert(incremental.begin(), parent);
+            fresh.insert(fresh.begin(), parent);
+            EXPECT_NEAR(routeCost(*grid, incremental), routeCost(*grid, fresh), 1e-6);
+            // what the negotiation loop does between reroutes
+            grid->addPathCost(incremental);
+            grid->addHistoryCost({A_Star::Point(cell(rng), cell(rng)), A_Star::Point(cell(rng), cell(rng))});
+            grid->addObstacle(A_Star::Point(cell(rng), cell(rng)));
+        }
+    }
+    // a net keeps its tree as long as its last search found a path
+    EXPECT_EQ(grid->incremental_trees.size(), routed);
+}
+
+// Test the cached distance fields give the same route costs as the octile heuristic
+TEST_F(GridTest, DistanceHeuristicCost)
+{
+    std::mt19937 rng(13);
+    std::uniform_int_distribution<int> cell(5, 94);
+    for (int y = 10; y < 90; ++y)
+    {
+        grid->addObstacle(A_Star::Point(50, y)); // a wall the octile estimate does not see
+    }
+    for (int i = 0; i < 300; ++i)
+    {
+        grid->addObstacle(A_Star::Point(cell(rng), cell(rng)));
+    }
+    std::vector<A_Star::Point> goals{A_Star::Point(80, 50), A_Star::Point(70, 20)};
+    for (int round = 0; round < 12; ++round)
+    {
+        const A_Star::Point start(cell(rng), cell(rng));
+        const A_Star::Point &goal = goals[round % goals.size()];
+        A_Star::Point parent(start.x - 1, start.y);
+        grid->distance_heuristic = false;
+        auto octile = grid->a_star_search(start, goal, parent);
+        grid->distance_heuristic = true;
+        auto field = grid->a_star_search(start, goal, parent);
+        ASSERT_EQ(field.empty(), octile.empty());
+        if (field.empty())
+        {
+            continue;
+        }
+        field.insert(field.begin(), parent);
+        octile.insert(octile.begin(), parent);
+        EXPECT_NEAR(routeCost(*grid, field), routeCost(*grid, octile), 1e-6);
+        grid->addPathCost(field);
+    }
+    EXPECT_EQ(grid->distance_fields.size(), goals.size());
+    // a removed obstacle can shorten distances, the field of the next search is computed again
+    grid->clearObstacle(A_Star::Point(50, 50));
+    grid->a_star_search(A_Star::Point(20, 50), goals[0], A_Star::Point(19, 50));
+    EXPECT_EQ(grid->distance_fields.at(grid->cellIndex(goals[0])).obstacle_version, grid->obstacle_version);
+    // over the budget only the field in use stays
+    grid->distance_field_budget = 1;
+    grid->a_star_search(A_Star::Point(20, 50), goals[1], A_Star::Point(19, 50));
+    EXPECT_EQ(grid->distance_fields.size(), 1u);
+    EXPECT_EQ(grid->distance_fields.count(grid->cellIndex(goals[1])), 1u);
+}
+
+// Test the coarse route goes around blocked GR cells and the fine search stays in its region
+TEST_F(GridTest, CoarseToFineRoute)
+{
+    for (int x = 40; x < 60; ++x)
+    {
+        for (int y = 0; y < 80; ++y)
+        {
+            grid->addObstacle(A_Star::Point(x, y));
+        }
+    }
+    A_Star::CoarseGrid coarse(*grid, std::make_pair(-5.0, 0.0), 10.0, 10.0);
+    EXPECT_TRUE(coarse.origin == A_Star::Point(0, 0));
+    EXPECT_EQ(coarse.rows, 11);
+    EXPECT_EQ(coarse.cols, 10);
+    EXPECT_TRUE(coarse.cellOf(A_Star::Point(15, 5)) == A_Star::Point(2, 0));
+    EXPECT_DOUBLE_EQ(coarse.capacity[coarse.index(A_Star::Point(5, 3))], 0);
+
+    const A_Star::Point start(10, 10), goal(90, 10);
+    auto cells = coarse.route(start, goal);
+    ASSERT_FALSE(cells.empty());
+    EXPECT_TRUE(cells.front() == coarse.cellOf(start));
+    EXPECT_TRUE(cells.back() == coarse.cellOf(goal));
+    for (const auto &cell : cells)
+    {
+        EXPECT_GT(coarse.capacity[coarse.index(cell)], 0);
+    }
+    auto region = coarse.region(cells, 1);
+    auto path = grid->a_star_search(start, goal, A_Star::Point(9, 10), std::nullopt, &region);
+    ASSERT_FALSE(path.empty());
+    for (const auto &p : path)
+    {
+        EXPECT_TRUE(region.contains(p));
+    }
+    auto full = grid->a_star_search(start, goal, A_Star::Point(9, 10));
+    path.insert(path.begin(), A_Star::Point(9, 10));
+    full.insert(full.begin(), A_Star::Point(9, 10));
+    EXPECT_GE(routeCost(*grid, path), routeCost(*grid, full) - 1e-6);
+
+    // full cells are avoided by the next coarse route
+    std::vector<A_Star::Point> crowded(cells.begin() + 1, cells.end() - 1);
+    for (int i = 0; i < 20; ++i)
+    {
+        coarse.addUsage(crowded, 1);
+    }
+    auto detour = coarse.route(start, goal);
+    ASSERT_FALSE(detour.empty());
+    for (const auto &cell : crowded)
+    {
+        EXPECT_EQ(std::count(detour.begin(), detour.end(), cell), 0);
+    }
+}
+
+// Test a corridor bounds the search and reports when it was in the way
+TEST_F(GridTest, CorridorAndWindowEdge)
+{
+    for (int y = 0; y < 60; ++y)
+    {
+        grid->addObstacle(A_Star::Point(50, y));
+    }
+    A_Star::Window corridor{10, 5, 80, 40};
+    auto bounded = grid->a_star_search(A_Star::Point(20, 20), A_Star::Point(70, 20), A_Star::Point(19, 20), corridor);
+    EXPECT_TRUE(bounded.empty());
+    EXPECT_TRUE(grid->hit_window_edge);
+    auto open = grid->a_star_search(A_Star::Point(20, 20), A_Star::Point(70, 20), A_Star::Point(19, 20));
+    ASSERT_FALSE(open.empty());
+    auto inside = grid->a_star_search(A_Star::Point(20, 20), A_Star::Point(40, 30), A_Star::Point(19, 20), corridor);
+    ASSERT_FALSE(inside.empty());
+    for (const auto &p : inside)
+    {
+        EXPECT_TRUE(corridor.contains(p));
+    }
+}
+
+// Test a grown grid keeps obstacles and costs of the old window at the shifted cells
+TEST_F(GridTest, CopyFromOffsetGrid)
+{
+    grid->addObstacle(A_Star::Point(3, 4));
+    grid->addPathCost({A_Star::Point(7, 8)});
+    A_Star::Grid grown(Coordinate(-20, -10, 0), Coordinate(120.5, 110.5, 0), 1.0);
+    grown.addObstacle(A_Star::Point(5, 5));
+    grown.addObstacle(A_Star::Point(23, 14)); // cell (3, 4) of grid was cleared, e.g. an escape point
+    grid->clearObstacle(A_Star::Point(3, 4));
+    grown.copyFrom(*grid);
+    A_Star::Point offset = grown.fromGrid(*grid, A_Star::Point(0, 0));
+    EXPECT_EQ(offset.x, 20);
+    EXPECT_EQ(offset.y, 10);
+    EXPECT_TRUE(grown.isObstacle(5, 5));
+    EXPECT_FALSE(grown.isObstacle(23, 14));
+    EXPECT_DOUBLE_EQ(grown.cost(27, 18), grid->path_cost);
+    EXPECT_TRUE(grown.toPoint(Coordinate(-0.5, 3.2, 0)) == A_Star::Point(19, 13));
+    EXPECT_TRUE(grid->toPoint(Coordinate(-0.5, 3.2, 0)) == A_Star::Point(-1, 3));
+}
+
+// Test a run-length path gives back its points and one segment per run
+TEST_F(GridTest, RunLengthPathSegments)
+{
+    std::vector<A_Star::Point> points;
+    for (int x = 10; x <= 15; ++x)
+    {
+        points.emplace_back(x, 20);
+    }
+    for (int i = 1; i <= 3; ++i)
+    {
+        points.emplace_back(15 + i, 20 + i);
+    }
+    for (int y = 24; y <= 30; ++y)
+    {
+        points.emplace_back(18, y);
+    }
+    A_Star::RunLengthPath path(points);
+    EXPECT_EQ(path.runs.size(), 3u);
+    EXPECT_EQ(path.size(), points.size());
+    auto decoded = path.points();
+    ASSERT_EQ(decoded.size(), points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        EXPECT_TRUE(decoded[i] == points[i]);
+    }
+    auto segments = grid->runs2segments(path, 1, 0);
+    ASSERT_EQ(segments.size(), 3u);
+    EXPECT_TRUE(segments.front().start() == Coordinate(10.5, 20.5, 0));
+    EXPECT_TRUE(segments[1].start() == Coordinate(15.5, 20.5, 0));
+    EXPECT_TRUE(segments.back().end() == Coordinate(18.5, 30.5, 0));
+    path.trim();
+    EXPECT_EQ(path.size(), points.size() - 2);
+    EXPECT_TRUE(path.start == points[1]);
+    EXPECT_TRUE(path.points().back() == points[points.size() - 2]);
+    EXPECT_THROW(A_Star::RunLengthPath({A_Star::Point(0, 0), A_Star::Point(2, 0)}), std::runtime_error);
+}
+
+// Test min-cost max-flow on the CSR network, and arcs added after a solve
+TEST_F(GridTest, FlowNetworkMinCostFlow)
+{
+    FlowNetwork network;
+    int32_t s = network.addVertex();
+    int32_t a = network.addVertex();
+    int32_t b = network.addVertex();
+    int32_t t = network.addVertex();
+    int32_t sa = network.addArc(s, a, 2, 1);
+    int32_t sb = network.addArc(s, b, 1, 4);
+    int32_t ab = network.addArc(a, b, 1, 1);
+    int32_t at = network.addArc(a, t, 1, 6);
+    int32_t bt = network.addArc(b, t, 2, 1);
+    // s-a-b-t costs 3, s-b-t 5 and s-a-t 7
+    auto [flow, cost] = network.minCostMaxFlow(s, t);
+    EXPECT_EQ(flow, 3);
+    EXPECT_EQ(cost, 15);
+    EXPECT_EQ(network.flow(sa), 2);
+    EXPECT_EQ(network.flow(sb), 1);
+    EXPECT_EQ(network.flow(ab), 1);
+    EXPECT_EQ(network.flow(at), 1);
+    EXPECT_EQ(network.flow(bt), 2);
+    EXPECT_EQ(network.residual(ab ^ 1), 1);
+    EXPECT_EQ(network.tail(ab ^ 1), b);
+    EXPECT_EQ(network.head(ab ^ 1), a);
+    EXPECT_EQ(network.cost(ab ^ 1), -1);
+    int32_t last = -1;
+    for (int32_t arc : network.arcs())
+    {
+        EXPECT_LE(last, network.tail(arc));
+        last = network.tail(arc);
+    }
+    // a new arc keeps the flows until the next solve, which starts over
+    int32_t st = network.addArc(s, t, 1, 0);
+    network.build();
+    EXPECT_EQ(network.flow(ab), 1);
+    EXPECT_EQ(network.flow(st), 0);
+    network.setCapacity(ab, 0);
+    std::tie(flow, cost) = network.minCostMaxFlow(s, t);
+    EXPECT_EQ(flow, 3);
+    EXPECT_EQ(cost, 12); // s-t, s-b-t and s-a-t
+    EXPECT_EQ(network.flow(st), 1);
+    EXPECT_EQ(network.flow(ab), 0);
+}
+
+TEST_F(GridTest, FlowNetworkWarmMaxFlow)
+{
+    FlowNetwork network;
+    int32_t s = network.addVertex();
+    int32_t a = network.addVertex();
+    int32_t b = network.addVertex();
+    int32_t t = network.addVertex();
+    int32_t sa = network.addArc(s, a, 1, 0);
+    int32_t sb = network.addArc(s, b, 1, 0);
+    int32_t ab = network.addArc(a, b, 1, 0);
+    int32_t at = network.addArc(a, t, 1, 0);
+    int32_t bt = network.addArc(b, t, 1, 0);
+    network.clearFlow();
+    // a seeded s-a-b-t blocks s-b-t, the search has to undo a-b
+    network.push(sa, 1);
+    network.push(ab, 1);
+    network.push(bt, 1);
+    EXPECT_EQ(network.maxFlow(s, t), 1);
+    EXPECT_EQ(network.flow(ab), 0);
+    EXPECT_EQ(network.flow(at), 1);
+    EXPECT_EQ(network.flow(sb), 1);
+    EXPECT_EQ(network.maxFlow(s, t), 0);
+    network.clearFlow();
+    EXPECT_EQ(network.flow(sa), 0);
+    EXPECT_EQ(network.maxFlow(s, t), 2);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
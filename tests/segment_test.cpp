@@ -228,9 +228,7 @@ TEST_F(SegmentTest, OctilePath)
     std::vector<Segment> path = Segment::generatePath(start, end);
 
     // Expected Path
-    std::vector<Segment> expected_path{Segment(Coordinate(1, 2, 0), Coordinate(2, 3, 0)),
-                                       Segment(Coordinate(2, 3, 0), Coordinate(3, 4, 0)),
-                                       Segment(Coordinate(3, 4, 0), Coordinate(4, 5, 0)),
+    std::vector<Segment> expected_path{Segment(Coordinate(1, 2, 0), Coordinate(4, 5, 0)),
                                        Segment(Coordinate(4, 5, 0), Coordinate(4, 6, 0))};
 
     ASSERT_EQ(path.size(), expected_path.size());
@@ -251,17 +249,9 @@ TEST_F(SegmentTest, OctilePathSpecific)
     // Generate Path
     std::vector<Segment> path = Segment::generatePath(start, end);
 
-    // Expected Path (example, adjust if necessary)
-    std::vector<Segment> expected_path{Segment(Coordinate(10.512, 12.212, 0), Coordinate(11.512, 13.212, 0)),
-                                       Segment(Coordinate(11.512, 13.212, 0), Coordinate(12.512, 14.212, 0)),
-                                       Segment(Coordinate(12.512, 14.212, 0), Coordinate(13.512, 15.212, 0)),
-                                       Segment(Coordinate(13.512, 15.212, 0), Coordinate(14.512, 16.212, 0)),
-                                       Segment(Coordinate(14.512, 16.212, 0), Coordinate(15.512, 17.212, 0)),
-                                       Segment(Coordinate(15.512, 17.212, 0), Coordinate(16.512, 18.212, 0)),
-                                       Segment(Coordinate(16.512, 18.212, 0), Coordinate(17.512, 19.212, 0)),
-                                       Segment(Coordinate(17.512, 19.212, 0), Coordinate(18.512, 20.212, 0)),
-                                       Segment(Coordinate(18.512, 20.212, 0), Coordinate(19.123, 20.002, 0)),
-                                       Segment(Coordinate(19.123, 20.002, 0), Coordinate(20.123, 20.002, 0))};
+    // Expected Path, one diagonal and one orthogonal segment that ends exactly at end
+    std::vector<Segment> expected_path{Segment(Coordinate(10.512, 12.212, 0), Coordinate(18.302, 20.002, 0)),
+                                       Segment(Coordinate(18.302, 20.002, 0), Coordinate(20.123, 20.002, 0))};
 
     ASSERT_EQ(path.size(), expected_path.size());
 
@@ -269,7 +259,94 @@ TEST_F(SegmentTest, OctilePathSpecific)
     {
         EXPECT_EQ(path[i].start(), expected_path[i].start());
         EXPECT_EQ(path[i].end(), expected_path[i].end());
+    }    EXPECT_DOUBLE_EQ(path.back().end().x(), end.x());
+    EXPECT_DOUBLE_EQ(path.back().end().y(), end.y());
+
+}
+
+// Test the router merges collinear segments and puts a corner between perpendicular ones
+TEST_F(SegmentTest, RouterAddSegment)
+{
+    Router router;
+    router.addSegment(Segment(Coordinate(0, 0, 0), Coordinate(10, 0, 0), 1));
+    router.addSegment(Segment(Coordinate(30, 30, 0), Coordinate(40, 40, 0), 2));
+    router.addSegment(Segment(Coordinate(10, 0, 0), Coordinate(20, 0, 0), 1));
+    ASSERT_EQ(router.segments().size(), 2u);
+    expectCoordinateNear(router.segments()[0].start(), Coordinate(0, 0, 0));
+    expectCoordinateNear(router.segments()[0].end(), Coordinate(20, 0, 0));
+
+    router.addSegment(Segment(Coordinate(20, 0, 0), Coordinate(20, 40, 0), 1));
+    const auto &segments = router.segments();
+    ASSERT_EQ(segments.size(), 4u);
+    expectCoordinateNear(segments[0].end(), Coordinate(15, 0, 0));
+    expectCoordinateNear(segments[2].start(), Coordinate(20, 10, 0));
+    expectCoordinateNear(segments[3].start(), Coordinate(15, 0, 0));
+    expectCoordinateNear(segments[3].end(), Coordinate(20, 10, 0));
+    EXPECT_EQ(segments[3].net_id(), 1);
+}
+
+// Test a batch of collinear pieces is joined into one segment
+TEST_F(SegmentTest, RouterAddSegments)
+{
+    Router router;
+    router.addSegments({Segment(Coordinate(0, 0, 0), Coordinate(10, 0, 0), 3),
+                        Segment(Coordinate(10, 0, 0), Coordinate(20, 0, 0), 3),
+                        Segment(Coordinate(20, 0, 0), Coordinate(30, 0, 0), 3),
+                        Segment(Coordinate(0, 0, 1), Coordinate(10, 0, 1), 4)});
+    ASSERT_EQ(router.segments().size(), 2u);
+    const auto &joined = router.segments()[router.segments()[0].layer() == 0 ? 0 : 1];
+    EXPECT_DOUBLE_EQ(std::min(joined.start().x(), joined.end().x()), 0);
+    EXPECT_DOUBLE_EQ(std::max(joined.start().x(), joined.end().x()), 30);
+    EXPECT_EQ(joined.net_id(), 3);
+}
+
+// Test segment handles survive other segments being merged and removed, and die with their own segment
+TEST_F(SegmentTest, RouterSegmentHandles)
+{
+    Router router;
+    router.addSegments({Segment(Coordinate(0, 0, 0), Coordinate(10, 0, 0), 1),
+                        Segment(Coordinate(0, 20, 0), Coordinate(10, 20, 0), 2),
+                        Segment(Coordinate(0, 40, 0), Coordinate(10, 40, 0), 3)});
+    SegmentHandle first = router.handle(0), second = router.handle(1), third = router.handle(2);
+    router.removeSegment(first);
+    EXPECT_FALSE(router.isValid(first));
+    EXPECT_TRUE(router.isValid(third));
+    // merged into the second segment, the handle of the second one keeps pointing at the merged segment
+    router.addSegment(Segment(Coordinate(10, 20, 0), Coordinate(30, 20, 0), 2));
+    ASSERT_EQ(router.segments().size(), 2u);
+    ASSERT_TRUE(router.isValid(second));
+    EXPECT_DOUBLE_EQ(router.segment(second).end().x(), 30);
+    EXPECT_DOUBLE_EQ(router.segment(third).start().y(), 40);
+    // the released slot is reused, the old handle still does not resolve
+    router.addSegment(Segment(Coordinate(50, 50, 0), Coordinate(60, 50, 0), 4));
+    EXPECT_FALSE(router.isValid(first));
+    router.removeSegment(router.handle(2));
+    router.removeSegment(third);
+    EXPECT_EQ(router.segments().size(), 1u);
+    EXPECT_EQ(router.segment(second).net_id(), 2);
+}
+
+// Test net ids spread over touching segments and vias, and different nets that touch are reported
+TEST_F(SegmentTest, RouterSetNetId)
+{
+    Router router;
+    router.addSegments({Segment(Coordinate(0, 0, 0), Coordinate(10, 10, 0), 5),
+                        Segment(Coordinate(10, 10, 0), Coordinate(10, 40, 0), -1),
+                        Segment(Coordinate(20, 40, 1), Coordinate(20, 60, 1), -1),
+                        Segment(Coordinate(100, 100, 0), Coordinate(110, 100, 0), -1)});
+    router.addVia(Via(Coordinate(10, 40, 0), 1));
+    router.addSegment(Segment(Coordinate(10, 40, 1), Coordinate(20, 40, 1), -1));
+    router.setNetId();
+    const auto &segments = router.segments();
+    for (const auto &seg : segments)
+    {
+        bool connected = seg.start().x() < 50; // the layer 1 pieces are reached through the via
+        EXPECT_EQ(seg.net_id(), connected ? 5 : -1);
     }
+    EXPECT_EQ(router.vias()[0].net_id(), 5);
+    router.addSegment(Segment(Coordinate(110, 100, 0), Coordinate(110, 120, 0), 7));
+    router.addVia(Via(Coordinate(105, 100, 0), 1, 8));
+    EXPECT_THROW(router.setNetId(), std::runtime_error);
 }
 
 int main(int argc, char **argv)